@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Generators.hpp"
+
+/**********************************************************************************************************************
+                                        Headless benchmark
+        Times recalculate(), countVerticies(), render() and update() on their own for each generator, grid size and iso level count.
+        No window, vsync or frame limiter is involved, so the numbers only depend on the marching code.
+**********************************************************************************************************************/
+
+//Every allocation in the process goes through here so each stage can report how many it made.
+//All the plain, array and aligned forms are replaced together so every new is paired with its own delete. The deletes are kept out of line,
+//otherwise GCC inlines free() next to a call it knows as operator new and warns about a mismatch (-Wmismatched-new-delete).
+static std::atomic<size_t> gAllocationCount{0};
+
+#if defined(__GNUC__)
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#else
+#define BENCHMARK_NOINLINE
+#endif
+
+static void *countedAllocate(const size_t size, const std::align_val_t alignment = std::align_val_t{alignof(std::max_align_t)})
+{
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<size_t>(alignment);
+    void *memory;
+    if(align <= alignof(std::max_align_t))
+        memory = std::malloc(size ? size : 1);
+    else
+#ifdef _WIN32
+        memory = _aligned_malloc(size ? size : 1, align);
+#else
+        memory = std::aligned_alloc(align, std::max(((size + align - 1) / align) * align, align)); //The size has to be a non-zero multiple of the alignment
+#endif
+    if(!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+BENCHMARK_NOINLINE static void countedFree(void *memory, const std::align_val_t alignment = std::align_val_t{alignof(std::max_align_t)}) noexcept
+{
+#ifdef _WIN32
+    if(static_cast<size_t>(alignment) > alignof(std::max_align_t))
+    {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    (void)alignment; //aligned_alloc() memory is freed with free()
+#endif
+    std::free(memory);
+}
+
+void *operator new(size_t size) { return countedAllocate(size); }
+void *operator new[](size_t size) { return countedAllocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, alignment); }
+
+BENCHMARK_NOINLINE void operator delete(void *memory) noexcept { countedFree(memory); }
+BENCHMARK_NOINLINE void operator delete[](void *memory) noexcept { countedFree(memory); }
+BENCHMARK_NOINLINE void operator delete(void *memory, size_t) noexcept { countedFree(memory); }
+BENCHMARK_NOINLINE void operator delete[](void *memory, size_t) noexcept { countedFree(memory); }
+BENCHMARK_NOINLINE void operator delete(void *memory, std::align_val_t alignment) noexcept { countedFree(memory, alignment); }
+BENCHMARK_NOINLINE void operator delete[](void *memory, std::align_val_t alignment) noexcept { countedFree(memory, alignment); }
+BENCHMARK_NOINLINE void operator delete(void *memory, size_t, std::align_val_t alignment) noexcept { countedFree(memory, alignment); }
+BENCHMARK_NOINLINE void operator delete[](void *memory, size_t, std::align_val_t alignment) noexcept { countedFree(memory, alignment); }
+
+//Stores the vertices like a real output would, but doesn't draw them.
+class BenchmarkOutput : public ISquaresOutput
+{
+    std::vector<SquaresVertex> mVertices;
+
+public:
+    void resetVertices(size_t vertexCount) override
+    {
+        mVertices.resize(vertexCount);
+    }
+
+    void addVertex(double, double x, double y) override
+    {
+        mVertices.push_back({static_cast<float>(x), static_cast<float>(y)});
+    }
+
+    void setVertex(size_t vertexIndex, double x, double y) override
+    {
+        mVertices[vertexIndex] = {static_cast<float>(x), static_cast<float>(y)};
+    }
+
+    void writeVertices(size_t firstVertex, size_t, std::span<const SquaresVertex> vertices) override
+    {
+        std::copy(vertices.begin(), vertices.end(), mVertices.begin() + static_cast<std::ptrdiff_t>(firstVertex));
+    }
+};
+
+//Same again for renderPolylines()
+class BenchmarkPolylineOutput : public ISquaresPolylineOutput
+{
+    std::vector<std::vector<SquaresVertex>> mLevelVertices;
+    std::vector<std::vector<SquaresPolyline>> mLevelPolylines;
+
+public:
+    void resetPolylines(const std::vector<double> &isoLevels) override
+    {
+        mLevelVertices.resize(isoLevels.size());
+        mLevelPolylines.resize(isoLevels.size());
+    }
+
+    void addPolylines(size_t isoLevelIndex, std::span<const SquaresVertex> vertices, std::span<const SquaresPolyline> polylines) override
+    {
+        mLevelVertices[isoLevelIndex].assign(vertices.begin(), vertices.end());
+        mLevelPolylines[isoLevelIndex].assign(polylines.begin(), polylines.end());
+    }
+};
+
+//Same again for update()
+class BenchmarkChunkedOutput : public ISquaresChunkedOutput
+{
+    std::vector<std::vector<SquaresVertex>> mChunks;
+    size_t mChunkCount = 0;
+
+public:
+    void resetChunks(size_t chunkCountX, size_t chunkCountY, const std::vector<double> &isoLevels) override
+    {
+        mChunkCount = chunkCountX * chunkCountY;
+        mChunks.resize(mChunkCount * isoLevels.size());
+    }
+
+    void updateChunk(size_t chunkIndex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override
+    {
+        mChunks[(isoLevelIndex * mChunkCount) + chunkIndex].assign(vertices.begin(), vertices.end());
+    }
+};
+
+//A stored field where every step only rewrites a small square that wanders across the grid, for timing update() on sparse changes.
+class SparseEditGenerator : public ISquaresGenerator
+{
+    constexpr static size_t EditSize = 8;
+    size_t mResolutionX, mResolutionY;
+    std::vector<double> mPoints;
+    std::vector<SquaresRect> mDirtyRects;
+    std::default_random_engine mRandom;
+
+public:
+    SparseEditGenerator(size_t resolutionX, size_t resolutionY, size_t seed) : mResolutionX(resolutionX), mResolutionY(resolutionY), mPoints(resolutionX * resolutionY), mRandom(seed)
+    {
+        PerlinHeightmapGenerator perlin(resolutionX, resolutionY, seed);
+        for(size_t y = 0; y < resolutionY; y++)
+            perlin.getRow(0, y, std::span(mPoints).subspan(y * resolutionX, resolutionX));
+    }
+
+    double getPoint(size_t x, size_t y) override
+    {
+        return mPoints[(y * mResolutionX) + x];
+    }
+
+    bool getDirtyRects(std::vector<SquaresRect> &dirtyRects) override
+    {
+        dirtyRects.insert(dirtyRects.end(), mDirtyRects.begin(), mDirtyRects.end());
+        mDirtyRects.clear();
+        return true;
+    }
+
+    void step()
+    {
+        const size_t editX = std::uniform_int_distribution<size_t>(0, mResolutionX - std::min(EditSize, mResolutionX))(mRandom);
+        const size_t editY = std::uniform_int_distribution<size_t>(0, mResolutionY - std::min(EditSize, mResolutionY))(mRandom);
+        std::uniform_real_distribution<double> valueDist(0.0, 1.0);
+        for(size_t y = editY; y < std::min(editY + EditSize, mResolutionY); y++)
+            for(size_t x = editX; x < std::min(editX + EditSize, mResolutionX); x++)
+                mPoints[(y * mResolutionX) + x] = valueDist(mRandom);
+        mDirtyRects.push_back({editX, editY, EditSize, EditSize});
+    }
+};
+
+struct StageResult
+{
+    double nanosecondsPerCall = 0.0;
+    double allocationsPerCall = 0.0;
+    size_t calls = 0;
+};
+
+//Run stage until at least minimumSeconds have passed (and at least 3 times), after one untimed warm up call.
+static StageResult timeStage(const std::function<void()> &stage, double minimumSeconds)
+{
+    stage();
+
+    StageResult result;
+    const size_t allocationsBefore = gAllocationCount.load();
+    const auto startTime = std::chrono::steady_clock::now();
+    double elapsedSeconds = 0.0;
+    while(result.calls < 3 || elapsedSeconds < minimumSeconds)
+    {
+        stage();
+        result.calls++;
+        elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    result.nanosecondsPerCall = (elapsedSeconds * 1e9) / static_cast<double>(result.calls);
+    result.allocationsPerCall = static_cast<double>(gAllocationCount.load() - allocationsBefore) / static_cast<double>(result.calls);
+    return result;
+}
+
+static std::vector<double> makeIsoLevels(size_t count)
+{
+    std::vector<double> isoLevels;
+    for(size_t i = 0; i < count; i++)
+        isoLevels.push_back(0.2 + (0.6 * static_cast<double>(i + 1)) / static_cast<double>(count + 1)); //Spread out over [0.2, 0.8]
+    return isoLevels;
+}
+
+struct BenchmarkCase
+{
+    std::string generatorName;
+    std::string pointType;
+    size_t resolution;
+    size_t isoLevelCount;
+    StageResult recalculate, count, render, update, polylines, isolines;
+    size_t vertexCount, polylineVertexCount;
+};
+
+//stepGenerator moves the generator on by a frame, update() is timed together with it so there is something to update.
+template<typename PointType>
+static BenchmarkCase runCase(const std::string &generatorName, const std::string &pointType, ISquaresGenerator &generator, const std::function<void()> &stepGenerator,
+                             size_t resolution, size_t isoLevelCount, ThreadPool *threadPool, double minimumSeconds)
+{
+    using Squares = MarchingSquares<std::dynamic_extent, std::dynamic_extent, std::dynamic_extent, std::dynamic_extent, PointType>;
+    BenchmarkOutput output;
+    Squares squares(generator, output, resolution, resolution, 4, 4);
+    squares.setThreadPool(threadPool);
+    const auto isoLevels = makeIsoLevels(isoLevelCount);
+
+    BenchmarkCase result{generatorName, pointType, resolution, isoLevelCount, {}, {}, {}, {}, {}, {}, 0, 0};
+    result.recalculate = timeStage([&squares]() { squares.recalculate(); }, minimumSeconds);
+    result.count = timeStage([&squares, &isoLevels]()
+    {
+        size_t vertexCount = 0;
+        for(const auto isoLevel : isoLevels)
+            vertexCount += squares.countVerticies(isoLevel);
+        if(vertexCount == std::numeric_limits<size_t>::max()) //Keeps the loop from being optimised away
+            std::abort();
+    }, minimumSeconds);
+    result.render = timeStage([&squares, &isoLevels, &result]() { result.vertexCount = squares.render(isoLevels); }, minimumSeconds);
+
+    BenchmarkPolylineOutput polylineOutput;
+    result.polylines = timeStage([&squares, &isoLevels, &polylineOutput, &result]() { result.polylineVertexCount = squares.renderPolylines(isoLevels, polylineOutput); }, minimumSeconds);
+
+    result.isolines = timeStage([&squares, &isoLevels]() { squares.renderIsolines(isoLevels); }, minimumSeconds);
+
+    BenchmarkChunkedOutput chunkedOutput;
+    Squares chunkedSquares(generator, chunkedOutput, resolution, resolution, 4, 4);
+    chunkedSquares.setThreadPool(threadPool);
+    result.update = timeStage([&chunkedSquares, &isoLevels, &stepGenerator]()
+    {
+        stepGenerator();
+        chunkedSquares.update(isoLevels);
+    }, minimumSeconds);
+    return result;
+}
+
+static BenchmarkCase runCase(const std::string &generatorName, const std::string &pointType, ISquaresGenerator &generator, const std::function<void()> &stepGenerator,
+                             size_t resolution, size_t isoLevelCount, ThreadPool *threadPool, double minimumSeconds)
+{
+    if(pointType == "float")
+        return runCase<float>(generatorName, pointType, generator, stepGenerator, resolution, isoLevelCount, threadPool, minimumSeconds);
+    if(pointType == "uint16")
+        return runCase<uint16_t>(generatorName, pointType, generator, stepGenerator, resolution, isoLevelCount, threadPool, minimumSeconds);
+    if(pointType == "uint8")
+        return runCase<uint8_t>(generatorName, pointType, generator, stepGenerator, resolution, isoLevelCount, threadPool, minimumSeconds);
+    return runCase<double>(generatorName, pointType, generator, stepGenerator, resolution, isoLevelCount, threadPool, minimumSeconds);
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: MarchingSquaresBenchmark [--format table|csv|json] [--threads n] [--min-time seconds] [--sizes a,b,c] [--levels a,b] [--points a,b]\n"
+                 "  --threads 0 (the default) runs single threaded\n"
+                 "  --points is a list of grid point types: double, float, uint16, uint8 (default all of them)\n";
+}
+
+static std::vector<std::string> splitList(const std::string &text)
+{
+    std::vector<std::string> values;
+    size_t start = 0;
+    while(start < text.size())
+    {
+        const size_t end = std::min(text.find(',', start), text.size());
+        values.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return values;
+}
+
+static std::vector<size_t> parseList(const std::string &text)
+{
+    std::vector<size_t> values;
+    for(const auto &value : splitList(text))
+        values.push_back(std::stoull(value));
+    return values;
+}
+
+int main(int argc, char **argv)
+{
+    std::string format = "table";
+    size_t threadCount = 0;
+    double minimumSeconds = 0.25;
+    std::vector<size_t> resolutions{200, 512, 1024, 2048};
+    std::vector<size_t> isoLevelCounts{3, 16};
+    std::vector<std::string> pointTypes{"double", "float", "uint16", "uint8"};
+
+    try
+    {
+        for(int i = 1; i < argc; i += 2)
+        {
+            const std::string option = argv[i];
+            if(i + 1 >= argc)
+            {
+                printUsage();
+                return 1;
+            }
+            const std::string value = argv[i+1];
+            if(option == "--format") format = value;
+            else if(option == "--threads") threadCount = std::stoull(value);
+            else if(option == "--min-time") minimumSeconds = std::stod(value);
+            else if(option == "--sizes") resolutions = parseList(value);
+            else if(option == "--levels") isoLevelCounts = parseList(value);
+            else if(option == "--points") pointTypes = splitList(value);
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+    }
+    catch(const std::exception &)
+    {
+        printUsage();
+        return 1;
+    }
+
+    const auto isPointType = [](const std::string &pointType) { return pointType == "double" || pointType == "float" || pointType == "uint16" || pointType == "uint8"; };
+    if((format != "table" && format != "csv" && format != "json") || !std::all_of(pointTypes.begin(), pointTypes.end(), isPointType))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::unique_ptr<ThreadPool> threadPool;
+    if(threadCount > 0)
+        threadPool = std::make_unique<ThreadPool>(threadCount);
+
+    std::vector<BenchmarkCase> results;
+    constexpr size_t Seed = 1234; //Fixed so runs can be compared
+    for(const auto &pointType : pointTypes)
+    {
+        for(const auto isoLevelCount : isoLevelCounts)
+        {
+            for(const auto resolution : resolutions)
+            {
+                constexpr double DepthIncrement = 0.0005; //Same as main
+                PerlinHeightmapGenerator perlin(resolution, resolution, Seed);
+                results.push_back(runCase("perlin", pointType, perlin, [&perlin]() { perlin.step(DepthIncrement); },
+                                          resolution, isoLevelCount, threadPool.get(), minimumSeconds));
+
+                MetaBallsGenerator metaBalls(resolution, resolution, Seed);
+                results.push_back(runCase("metaballs", pointType, metaBalls, [&metaBalls]() { metaBalls.step(DepthIncrement); },
+                                          resolution, isoLevelCount, threadPool.get(), minimumSeconds));
+
+                //Lots of small balls, only cheap with the influence cutoff
+                MetaBallsGenerator manyMetaBalls(resolution, resolution, Seed, 1000, std::max(resolution * 0.01, 3.0));
+                manyMetaBalls.setInfluenceCutoff(0.05);
+                results.push_back(runCase("metaballs1k", pointType, manyMetaBalls, [&manyMetaBalls]() { manyMetaBalls.step(DepthIncrement); },
+                                          resolution, isoLevelCount, threadPool.get(), minimumSeconds));
+
+                //Hundreds of ants, only the cells around them change each frame
+                TurmiteGenerator turmites(resolution, resolution, Seed, std::max<size_t>(resolution / 4, 2), "LLRR", 1);
+                turmites.getTurmites().setThreadPool(threadPool.get());
+                turmites.step(0.1); //So render() has trails to march instead of a blank board
+                results.push_back(runCase("turmites", pointType, turmites, [&turmites]() { turmites.step(DepthIncrement); },
+                                          resolution, isoLevelCount, threadPool.get(), minimumSeconds));
+
+                SparseEditGenerator sparseEdit(resolution, resolution, Seed);
+                results.push_back(runCase("sparseedit", pointType, sparseEdit, [&sparseEdit]() { sparseEdit.step(); },
+                                          resolution, isoLevelCount, threadPool.get(), minimumSeconds));
+            }
+
+            TestPattern testPattern; //Only 5x5 points
+            results.push_back(runCase("testpattern", pointType, testPattern, []() {}, 5, isoLevelCount, threadPool.get(), minimumSeconds));
+        }
+    }
+
+    if(Instrumentation::Enabled) //On stderr so csv and json output stay parseable
+        std::fprintf(stderr, "Note: built with MARCHING_SQUARES_INSTRUMENTATION, the timings include the cost of the timers and counters\n");
+
+    if(format == "table")
+        std::printf("%-12s %-6s %6s %6s | %14s %14s %14s %14s %14s %14s | %12s %12s %12s | %s\n", "generator", "points", "size", "levels",
+                    "recalc ns/pt", "count ns/cell", "render ns/cell", "update ns/cell", "lines ns/cell", "isoline ns/cell", "vertices", "Mvertices/s", "line verts",
+                    "allocs/call (recalc/count/render/update/lines/isolines)");
+    else if(format == "csv")
+        std::printf("generator,points,size,levels,threads,recalculate_ns,recalculate_ns_per_point,recalculate_allocs,count_ns,count_ns_per_cell,count_allocs,"
+                    "render_ns,render_ns_per_cell,render_allocs,update_ns,update_ns_per_cell,update_allocs,polylines_ns,polylines_ns_per_cell,polylines_allocs,"
+                    "isolines_ns,isolines_ns_per_cell,isolines_allocs,"
+                    "vertices,vertices_per_second,polyline_vertices\n");
+    else
+        std::printf("[\n");
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const auto &result = results[i];
+        const double points = static_cast<double>(result.resolution * result.resolution);
+        const double cells = static_cast<double>((result.resolution - 1) * (result.resolution - 1));
+        const double verticesPerSecond = static_cast<double>(result.vertexCount) / (result.render.nanosecondsPerCall * 1e-9);
+
+        if(format == "table")
+            std::printf("%-12s %-6s %6zu %6zu | %14.2f %14.2f %14.2f %14.2f %14.2f %14.2f | %12zu %12.1f %12zu | %.1f/%.1f/%.1f/%.1f/%.1f/%.1f\n", result.generatorName.c_str(), result.pointType.c_str(), result.resolution, result.isoLevelCount,
+                        result.recalculate.nanosecondsPerCall / points, result.count.nanosecondsPerCall / cells, result.render.nanosecondsPerCall / cells, result.update.nanosecondsPerCall / cells,
+                        result.polylines.nanosecondsPerCall / cells, result.isolines.nanosecondsPerCall / cells, result.vertexCount, verticesPerSecond / 1e6, result.polylineVertexCount,
+                        result.recalculate.allocationsPerCall, result.count.allocationsPerCall, result.render.allocationsPerCall, result.update.allocationsPerCall, result.polylines.allocationsPerCall,
+                        result.isolines.allocationsPerCall);
+        else if(format == "csv")
+            std::printf("%s,%s,%zu,%zu,%zu,%.0f,%.4f,%.2f,%.0f,%.4f,%.2f,%.0f,%.4f,%.2f,%.0f,%.4f,%.2f,%.0f,%.4f,%.2f,%.0f,%.4f,%.2f,%zu,%.0f,%zu\n", result.generatorName.c_str(), result.pointType.c_str(), result.resolution, result.isoLevelCount, threadCount,
+                        result.recalculate.nanosecondsPerCall, result.recalculate.nanosecondsPerCall / points, result.recalculate.allocationsPerCall,
+                        result.count.nanosecondsPerCall, result.count.nanosecondsPerCall / cells, result.count.allocationsPerCall,
+                        result.render.nanosecondsPerCall, result.render.nanosecondsPerCall / cells, result.render.allocationsPerCall,
+                        result.update.nanosecondsPerCall, result.update.nanosecondsPerCall / cells, result.update.allocationsPerCall,
+                        result.polylines.nanosecondsPerCall, result.polylines.nanosecondsPerCall / cells, result.polylines.allocationsPerCall,
+                        result.isolines.nanosecondsPerCall, result.isolines.nanosecondsPerCall / cells, result.isolines.allocationsPerCall,
+                        result.vertexCount, verticesPerSecond, result.polylineVertexCount);
+        else
+            std::printf("  {\"generator\": \"%s\", \"points\": \"%s\", \"size\": %zu, \"levels\": %zu, \"threads\": %zu, "
+                        "\"recalculate\": {\"ns\": %.0f, \"ns_per_point\": %.4f, \"allocs\": %.2f}, "
+                        "\"count\": {\"ns\": %.0f, \"ns_per_cell\": %.4f, \"allocs\": %.2f}, "
+                        "\"render\": {\"ns\": %.0f, \"ns_per_cell\": %.4f, \"allocs\": %.2f}, "
+                        "\"update\": {\"ns\": %.0f, \"ns_per_cell\": %.4f, \"allocs\": %.2f}, "
+                        "\"polylines\": {\"ns\": %.0f, \"ns_per_cell\": %.4f, \"allocs\": %.2f}, "
+                        "\"isolines\": {\"ns\": %.0f, \"ns_per_cell\": %.4f, \"allocs\": %.2f}, "
+                        "\"vertices\": %zu, \"vertices_per_second\": %.0f, \"polyline_vertices\": %zu}%s\n",
+                        result.generatorName.c_str(), result.pointType.c_str(), result.resolution, result.isoLevelCount, threadCount,
+                        result.recalculate.nanosecondsPerCall, result.recalculate.nanosecondsPerCall / points, result.recalculate.allocationsPerCall,
+                        result.count.nanosecondsPerCall, result.count.nanosecondsPerCall / cells, result.count.allocationsPerCall,
+                        result.render.nanosecondsPerCall, result.render.nanosecondsPerCall / cells, result.render.allocationsPerCall,
+                        result.update.nanosecondsPerCall, result.update.nanosecondsPerCall / cells, result.update.allocationsPerCall,
+                        result.polylines.nanosecondsPerCall, result.polylines.nanosecondsPerCall / cells, result.polylines.allocationsPerCall,
+                        result.isolines.nanosecondsPerCall, result.isolines.nanosecondsPerCall / cells, result.isolines.allocationsPerCall,
+                        result.vertexCount, verticesPerSecond, result.polylineVertexCount, (i + 1 < results.size()) ? "," : "");
+    }
+
+    if(format == "json")
+        std::printf("]\n");
+    return 0;
+}
@@ -0,0 +1,452 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MappedFile.hpp"
+#include "MarchingSquares.hpp"
+
+//Binary archive of contour output, one frame per render() (or per band of a StreamingMarchingSquares run).
+//All values are native endian and every record starts on an 8 byte boundary, so a mapped archive can be read in place.
+//
+//  Header     "MSCA", uint32 version, uint32 vertices per primitive (3 triangles, 2 line segments), uint32 reserved
+//  Frame      uint32 level count, uint32 reserved, level count x {double iso level, uint64 vertex count},
+//             then the vertices of every level in order as float x, y
+//  Index      frame count x {uint64 offset, uint64 size}
+//  Trailer    uint64 index offset, uint64 frame count, "MSCI", uint32 version
+//
+//The index is written last, so a reader goes straight from the trailer to any frame.
+namespace ContourArchive
+{
+    constexpr uint32_t Version = 1;
+    constexpr char HeaderMagic[4] = {'M', 'S', 'C', 'A'};
+    constexpr char TrailerMagic[4] = {'M', 'S', 'C', 'I'};
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t verticesPerPrimitive;
+        uint32_t reserved;
+    };
+
+    struct FrameHeader
+    {
+        uint32_t levelCount;
+        uint32_t reserved;
+    };
+
+    struct LevelHeader
+    {
+        double isoLevel;
+        uint64_t vertexCount;
+    };
+
+    struct IndexEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Trailer
+    {
+        uint64_t indexOffset;
+        uint64_t frameCount;
+        char magic[4];
+        uint32_t version;
+    };
+
+    static_assert(sizeof(SquaresVertex) == 8 && sizeof(Header) % 8 == 0 && sizeof(FrameHeader) % 8 == 0 && sizeof(LevelHeader) % 8 == 0,
+                  "Records have to stay 8 byte aligned");
+}
+
+//An ISquaresOutput that streams frames to an archive. Frames are handed to a background thread that sorts them by iso level and writes them out,
+//double buffered so the next frame is contoured while the last one is written. Handing a frame over is a swap of buffers, the contouring thread
+//only waits when the disk falls a whole frame behind.
+//A frame ends at the next resetVertices(), finishFrame() or close().
+class ContourArchiveWriter : public ISquaresOutput
+{
+    struct Frame
+    {
+        std::vector<double> isoLevels;
+        std::vector<SquaresVertex> vertices;
+        std::vector<uint32_t> vertexIsoLevels; //Index into isoLevels for every vertex
+    };
+
+    std::FILE *mFile;
+    Frame mFilling;                 //Being written to by MarchingSquares
+    Frame mWriting;                 //Being written to disk
+    bool mFrameStarted = false;
+    bool mWriterBusy = false;
+    bool mClosing = false;
+    std::exception_ptr mWriterError;
+    std::mutex mSync;
+    std::condition_variable mWriterSignal;
+    std::thread mWriterThread;
+
+    //Writer thread state
+    uint64_t mOffset = 0;
+    std::vector<ContourArchive::IndexEntry> mIndex;     //Guarded by mSync, read by getFrameCount()
+    std::vector<SquaresVertex> mSortedVertices;
+    std::vector<ContourArchive::LevelHeader> mLevelHeaders;
+
+    void write(const void *data, const size_t size)
+    {
+        if(size > 0 && std::fwrite(data, 1, size, mFile) != size)
+            throw std::runtime_error("Unable to write the contour archive");
+        mOffset += size;
+    }
+
+    size_t getIsoLevelIndex(const double isoLevel)
+    {
+        auto &isoLevels = mFilling.isoLevels;
+        const auto found = std::find(isoLevels.begin(), isoLevels.end(), isoLevel);
+        if(found != isoLevels.end())
+            return static_cast<size_t>(found - isoLevels.begin());
+        isoLevels.push_back(isoLevel);
+        return isoLevels.size() - 1;
+    }
+
+    //Counting sort by iso level, render() already writes the levels in order but addVertex() callers might not.
+    //Returns the frame's index entry, it's added to mIndex under mSync so getFrameCount() can read it from other threads.
+    ContourArchive::IndexEntry writeFrame(const Frame &frame)
+    {
+        mLevelHeaders.assign(frame.isoLevels.size(), {0.0, 0});
+        for(size_t isoLevelIndex = 0; isoLevelIndex < frame.isoLevels.size(); isoLevelIndex++)
+            mLevelHeaders[isoLevelIndex].isoLevel = frame.isoLevels[isoLevelIndex];
+        for(const auto isoLevelIndex : frame.vertexIsoLevels)
+            mLevelHeaders[isoLevelIndex].vertexCount++;
+
+        std::vector<uint64_t> nextVertex(frame.isoLevels.size(), 0);
+        for(size_t isoLevelIndex = 1; isoLevelIndex < frame.isoLevels.size(); isoLevelIndex++)
+            nextVertex[isoLevelIndex] = nextVertex[isoLevelIndex - 1] + mLevelHeaders[isoLevelIndex - 1].vertexCount;
+        mSortedVertices.resize(frame.vertices.size());
+        for(size_t i = 0; i < frame.vertices.size(); i++)
+            mSortedVertices[nextVertex[frame.vertexIsoLevels[i]]++] = frame.vertices[i];
+
+        const ContourArchive::FrameHeader header{static_cast<uint32_t>(frame.isoLevels.size()), 0};
+        const uint64_t frameOffset = mOffset;
+        write(&header, sizeof(header));
+        write(mLevelHeaders.data(), mLevelHeaders.size() * sizeof(ContourArchive::LevelHeader));
+        write(mSortedVertices.data(), mSortedVertices.size() * sizeof(SquaresVertex));
+        return {frameOffset, mOffset - frameOffset};
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock lock(mSync);
+        while(true)
+        {
+            mWriterSignal.wait(lock, [this]() { return mWriterBusy || mClosing; });
+            if(!mWriterBusy)
+                return;
+
+            lock.unlock();
+            ContourArchive::IndexEntry entry{};
+            std::exception_ptr error;
+            try
+            {
+                if(!mWriterError)
+                    entry = writeFrame(mWriting);
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+            if(error)
+                mWriterError = error; //Rethrown on the contouring thread by the next finishFrame() or close()
+            else if(!mWriterError)
+                mIndex.push_back(entry);
+            mWriterBusy = false;
+            mWriterSignal.notify_all();
+        }
+    }
+
+public:
+    explicit ContourArchiveWriter(const std::string &path, uint32_t verticesPerPrimitive = 3) : mFile(std::fopen(path.c_str(), "wb"))
+    {
+        if(!mFile)
+            throw std::runtime_error("Unable to open " + path);
+        std::setvbuf(mFile, nullptr, _IOFBF, 1 << 20);
+
+        ContourArchive::Header header{};
+        std::memcpy(header.magic, ContourArchive::HeaderMagic, sizeof(header.magic));
+        header.version = ContourArchive::Version;
+        header.verticesPerPrimitive = verticesPerPrimitive;
+        try
+        {
+            write(&header, sizeof(header));
+        }
+        catch(...)
+        {
+            std::fclose(mFile);
+            throw;
+        }
+        mWriterThread = std::thread([this]() { writerLoop(); });
+    }
+
+    ~ContourArchiveWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch(...) {} //Call close() to find out about errors
+    }
+
+    ContourArchiveWriter(const ContourArchiveWriter &) = delete;
+    ContourArchiveWriter &operator=(const ContourArchiveWriter &) = delete;
+
+    void setIsoLevels(const std::vector<double> &isoLevels) override
+    {
+        finishFrame(); //Comes before resetVertices(), so this is where a new frame from render() starts
+        mFilling.isoLevels = isoLevels;
+    }
+
+    void resetVertices(size_t vertexCount) override
+    {
+        if(mFrameStarted)
+            finishFrame();
+        mFrameStarted = true;
+        mFilling.vertices.resize(vertexCount);
+        mFilling.vertexIsoLevels.resize(vertexCount);
+    }
+
+    void addVertex(double isoLevel, double x, double y) override
+    {
+        mFrameStarted = true;
+        mFilling.vertices.push_back({static_cast<float>(x), static_cast<float>(y)});
+        mFilling.vertexIsoLevels.push_back(static_cast<uint32_t>(getIsoLevelIndex(isoLevel)));
+    }
+
+    void setVertex(size_t vertexIndex, double x, double y) override
+    {
+        mFilling.vertices[vertexIndex] = {static_cast<float>(x), static_cast<float>(y)};
+    }
+
+    void writeVertices(size_t firstVertex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override //Safe to call from several threads, like the real thing
+    {
+        std::copy(vertices.begin(), vertices.end(), mFilling.vertices.begin() + static_cast<std::ptrdiff_t>(firstVertex));
+        std::fill_n(mFilling.vertexIsoLevels.begin() + static_cast<std::ptrdiff_t>(firstVertex), vertices.size(), static_cast<uint32_t>(isoLevelIndex));
+    }
+
+    //Hand the current frame to the writer thread. Only waits if the writer is still busy with the frame before.
+    void finishFrame()
+    {
+        if(!mFrameStarted)
+            return;
+
+        std::unique_lock lock(mSync);
+        mWriterSignal.wait(lock, [this]() { return !mWriterBusy; });
+        if(mWriterError)
+            std::rethrow_exception(mWriterError);
+        std::swap(mFilling, mWriting); //mFilling gets the old buffers back, they keep their capacity
+        mFilling.isoLevels = mWriting.isoLevels;
+        mFilling.vertices.clear();
+        mFilling.vertexIsoLevels.clear();
+        mFrameStarted = false;
+        mWriterBusy = true;
+        mWriterSignal.notify_all();
+    }
+
+    //Write the last frame and the index. Called by the destructor, call it directly to hear about write errors.
+    //The writer thread is always stopped and the file always closed, even when this throws.
+    void close()
+    {
+        if(!mFile)
+            return;
+
+        std::exception_ptr error;
+        try
+        {
+            finishFrame();
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock(mSync);
+            mClosing = true;
+        }
+        mWriterSignal.notify_all();
+        if(mWriterThread.joinable())
+            mWriterThread.join();
+
+        if(!error)
+            error = mWriterError;
+        if(!error)
+        {
+            try
+            {
+                ContourArchive::Trailer trailer{mOffset, mIndex.size(), {}, ContourArchive::Version};
+                std::memcpy(trailer.magic, ContourArchive::TrailerMagic, sizeof(trailer.magic));
+                write(mIndex.data(), mIndex.size() * sizeof(ContourArchive::IndexEntry));
+                write(&trailer, sizeof(trailer));
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+        }
+
+        const bool closed = std::fclose(mFile) == 0; //Also flushes
+        mFile = nullptr;
+        if(error)
+            std::rethrow_exception(error);
+        if(!closed)
+            throw std::runtime_error("Unable to write the contour archive");
+    }
+
+    //Frames written to disk so far
+    size_t getFrameCount()
+    {
+        std::lock_guard lock(mSync);
+        return mIndex.size();
+    }
+};
+
+//Memory maps an archive and reads frames straight out of the mapping, any frame can be read without touching the ones before it.
+class ContourArchiveReader
+{
+    MappedFile mFile;
+    ContourArchive::Header mHeader{};
+    ContourArchive::Trailer mTrailer{};
+    const ContourArchive::IndexEntry *mIndex = nullptr;
+
+public:
+    //The levels of one frame, the vertices point into the mapping and stay valid as long as the reader.
+    struct Frame
+    {
+        std::vector<double> isoLevels;
+        std::vector<std::span<const SquaresVertex>> levelVertices;
+    };
+
+    explicit ContourArchiveReader(const std::string &path) : mFile(path)
+    {
+        if(mFile.size() < sizeof(ContourArchive::Header) + sizeof(ContourArchive::Trailer))
+            throw std::runtime_error(path + " is too small to be a contour archive");
+        std::memcpy(&mHeader, mFile.data(), sizeof(mHeader));
+        std::memcpy(&mTrailer, mFile.data() + mFile.size() - sizeof(mTrailer), sizeof(mTrailer));
+        if(std::memcmp(mHeader.magic, ContourArchive::HeaderMagic, sizeof(mHeader.magic)) != 0 || std::memcmp(mTrailer.magic, ContourArchive::TrailerMagic, sizeof(mTrailer.magic)) != 0)
+            throw std::runtime_error(path + " isn't a contour archive, or wasn't closed");
+        if(mHeader.version != ContourArchive::Version || mTrailer.version != ContourArchive::Version)
+            throw std::runtime_error(path + " is contour archive version " + std::to_string(mHeader.version) + ", expected " + std::to_string(ContourArchive::Version));
+        //Written so nothing overflows, the trailer can hold anything
+        const uint64_t indexEnd = mFile.size() - sizeof(mTrailer);
+        if(mTrailer.indexOffset < sizeof(mHeader) || mTrailer.indexOffset > indexEnd || mTrailer.indexOffset % 8 != 0 ||
+           mTrailer.frameCount != (indexEnd - mTrailer.indexOffset) / sizeof(ContourArchive::IndexEntry) ||
+           (indexEnd - mTrailer.indexOffset) % sizeof(ContourArchive::IndexEntry) != 0)
+            throw std::runtime_error(path + " has a damaged index");
+        mIndex = reinterpret_cast<const ContourArchive::IndexEntry *>(mFile.data() + mTrailer.indexOffset); //8 byte aligned, see ContourArchive
+    }
+
+    size_t getFrameCount() const
+    {
+        return static_cast<size_t>(mTrailer.frameCount);
+    }
+
+    uint32_t getVerticesPerPrimitive() const
+    {
+        return mHeader.verticesPerPrimitive;
+    }
+
+    Frame getFrame(const size_t frameIndex) const
+    {
+        if(frameIndex >= getFrameCount())
+            throw std::out_of_range("Contour archive frame " + std::to_string(frameIndex) + " of " + std::to_string(getFrameCount()));
+
+        //Everything is checked against the frame's index entry before it's read, and the entry against the file, so a damaged archive can't read outside the mapping
+        const auto damaged = [frameIndex]() { return std::runtime_error("Contour archive frame " + std::to_string(frameIndex) + " is damaged"); };
+        const auto &entry = mIndex[frameIndex];
+        if(entry.offset < sizeof(ContourArchive::Header) || entry.offset > mTrailer.indexOffset || entry.offset % 8 != 0 ||
+           entry.size > mTrailer.indexOffset - entry.offset || entry.size < sizeof(ContourArchive::FrameHeader))
+            throw damaged();
+
+        const uint8_t *record = mFile.data() + entry.offset;
+        const auto &header = *reinterpret_cast<const ContourArchive::FrameHeader *>(record);
+        uint64_t remaining = entry.size - sizeof(ContourArchive::FrameHeader);
+        if(header.levelCount > remaining / sizeof(ContourArchive::LevelHeader))
+            throw damaged();
+        remaining -= header.levelCount * sizeof(ContourArchive::LevelHeader);
+        const auto *levels = reinterpret_cast<const ContourArchive::LevelHeader *>(record + sizeof(ContourArchive::FrameHeader));
+        const auto *vertices = reinterpret_cast<const SquaresVertex *>(levels + header.levelCount);
+
+        Frame frame;
+        for(uint32_t isoLevelIndex = 0; isoLevelIndex < header.levelCount; isoLevelIndex++)
+        {
+            const uint64_t vertexCount = levels[isoLevelIndex].vertexCount;
+            if(vertexCount > remaining / sizeof(SquaresVertex))
+                throw damaged();
+            remaining -= vertexCount * sizeof(SquaresVertex);
+            frame.isoLevels.push_back(levels[isoLevelIndex].isoLevel);
+            frame.levelVertices.emplace_back(vertices, static_cast<size_t>(vertexCount));
+            vertices += vertexCount;
+        }
+        return frame;
+    }
+};
+
+//Text exports of an archived frame. Triangles become polygons and line segments become lines, one feature/path per iso level.
+namespace ContourExport
+{
+    inline void writeGeoJson(std::FILE *file, const ContourArchiveReader::Frame &frame, const uint32_t verticesPerPrimitive)
+    {
+        std::fprintf(file, "{\"type\": \"FeatureCollection\", \"features\": [");
+        for(size_t isoLevelIndex = 0; isoLevelIndex < frame.isoLevels.size(); isoLevelIndex++)
+        {
+            const bool polygons = verticesPerPrimitive >= 3;
+            std::fprintf(file, "%s\n  {\"type\": \"Feature\", \"properties\": {\"isoLevel\": %g}, \"geometry\": {\"type\": \"%s\", \"coordinates\": [",
+                         isoLevelIndex > 0 ? "," : "", frame.isoLevels[isoLevelIndex], polygons ? "MultiPolygon" : "MultiLineString");
+            const auto &vertices = frame.levelVertices[isoLevelIndex];
+            for(size_t first = 0; first + verticesPerPrimitive <= vertices.size(); first += verticesPerPrimitive)
+            {
+                std::fprintf(file, "%s%s", first > 0 ? "," : "", polygons ? "[[" : "[");
+                for(size_t i = 0; i <= verticesPerPrimitive; i++) //Polygons are closed by repeating their first vertex
+                {
+                    if(i == verticesPerPrimitive && !polygons)
+                        break;
+                    const auto &vertex = vertices[first + (i % verticesPerPrimitive)];
+                    std::fprintf(file, "%s[%g,%g]", i > 0 ? "," : "", vertex.x, vertex.y);
+                }
+                std::fprintf(file, "%s", polygons ? "]]" : "]");
+            }
+            std::fprintf(file, "]}}");
+        }
+        std::fprintf(file, "\n]}\n");
+    }
+
+    //width/height are the size of the picture in output units, levels go from dark to light in the order they were rendered.
+    inline void writeSvg(std::FILE *file, const ContourArchiveReader::Frame &frame, const uint32_t verticesPerPrimitive, const double width, const double height)
+    {
+        std::fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%g\" height=\"%g\" viewBox=\"0 0 %g %g\">\n", width, height, width, height);
+        for(size_t isoLevelIndex = 0; isoLevelIndex < frame.isoLevels.size(); isoLevelIndex++)
+        {
+            const int shade = static_cast<int>(64 + (191 * (isoLevelIndex + 1)) / frame.isoLevels.size());
+            if(verticesPerPrimitive >= 3)
+                std::fprintf(file, "  <path data-iso-level=\"%g\" fill=\"rgb(%d,%d,%d)\" stroke=\"none\" d=\"", frame.isoLevels[isoLevelIndex], shade, shade, shade);
+            else
+                std::fprintf(file, "  <path data-iso-level=\"%g\" fill=\"none\" stroke=\"rgb(%d,%d,%d)\" d=\"", frame.isoLevels[isoLevelIndex], shade, shade, shade);
+
+            const auto &vertices = frame.levelVertices[isoLevelIndex];
+            for(size_t first = 0; first + verticesPerPrimitive <= vertices.size(); first += verticesPerPrimitive)
+            {
+                for(size_t i = 0; i < verticesPerPrimitive; i++)
+                    std::fprintf(file, "%c%g %g", i == 0 ? 'M' : 'L', vertices[first + i].x, vertices[first + i].y);
+                if(verticesPerPrimitive >= 3)
+                    std::fprintf(file, "Z");
+            }
+            std::fprintf(file, "\"/>\n");
+        }
+        std::fprintf(file, "</svg>\n");
+    }
+}
@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ContourArchive.hpp"
+#include "StreamingContour.hpp"
+
+//Writes each band's triangles to a text file as soon as the band is done, one "isoLevel x0 y0 x1 y1 x2 y2" line per triangle.
+class TriangleTextOutput : public ISquaresOutput
+{
+    std::FILE *mFile;
+    std::vector<double> mIsoLevels;
+    std::vector<SquaresVertex> mVertices;   //The current band, never more than one band is held in memory.
+    std::vector<double> mVertexIsoLevels;
+
+    void flush()
+    {
+        for(size_t i = 0; i + 2 < mVertices.size(); i += 3)
+            std::fprintf(mFile, "%g %g %g %g %g %g %g\n", mVertexIsoLevels[i], mVertices[i].x, mVertices[i].y,
+                         mVertices[i+1].x, mVertices[i+1].y, mVertices[i+2].x, mVertices[i+2].y);
+        mVertices.clear();
+        mVertexIsoLevels.clear();
+        if(std::ferror(mFile)) //Checked once per band, so a full disk stops the run early
+            throw std::runtime_error("Unable to write the triangles");
+    }
+
+public:
+    explicit TriangleTextOutput(std::FILE *file) : mFile(file) {}
+
+    //Write the last band. The file is left open, fclose() it and check the result to know everything reached the disk.
+    void finish()
+    {
+        flush();
+    }
+
+    void resetVertices(size_t vertexCount) override //A new band has started
+    {
+        flush();
+        mVertices.resize(vertexCount);
+        mVertexIsoLevels.resize(vertexCount);
+    }
+
+    void addVertex(double isoLevel, double x, double y) override
+    {
+        mVertices.push_back({static_cast<float>(x), static_cast<float>(y)});
+        mVertexIsoLevels.push_back(isoLevel);
+    }
+
+    void setVertex(size_t vertexIndex, double x, double y) override
+    {
+        mVertices[vertexIndex] = {static_cast<float>(x), static_cast<float>(y)};
+    }
+
+    void setIsoLevels(const std::vector<double> &isoLevels) override
+    {
+        mIsoLevels = isoLevels;
+    }
+
+    void writeVertices(size_t firstVertex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override
+    {
+        std::copy(vertices.begin(), vertices.end(), mVertices.begin() + static_cast<std::ptrdiff_t>(firstVertex));
+        std::fill_n(mVertexIsoLevels.begin() + static_cast<std::ptrdiff_t>(firstVertex), vertices.size(), mIsoLevels[isoLevelIndex]);
+    }
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: MarchingSquaresCli <raster> <width> <height> <float32|float64|int16> <output> [options]\n"
+                 "  --levels a,b,c     iso levels to contour (default 0.3,0.4,0.5)\n"
+                 "  --band-rows n      rows of squares marched at a time (default 256)\n"
+                 "  --threads n        worker threads, 0 for single threaded (default: all cores)\n"
+                 "  --scale n          output units per raster sample (default 1)\n"
+                 "  --format f         text, one triangle per line, or archive, a binary contour archive with a frame per band (default text)\n";
+}
+
+static std::vector<double> parseLevels(const std::string &text)
+{
+    std::vector<double> levels;
+    std::stringstream stream(text);
+    std::string level;
+    while(std::getline(stream, level, ','))
+        levels.push_back(std::stod(level));
+    return levels;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 6 || (argc % 2) != 0) //Options come in pairs
+    {
+        printUsage();
+        return 1;
+    }
+
+    try
+    {
+        const std::string rasterPath = argv[1];
+        const size_t width = std::stoull(argv[2]);
+        const size_t height = std::stoull(argv[3]);
+        const std::string formatName = argv[4];
+        const std::string outputPath = argv[5];
+
+        RasterFormat format;
+        if(formatName == "float32") format = RasterFormat::Float32;
+        else if(formatName == "float64") format = RasterFormat::Float64;
+        else if(formatName == "int16") format = RasterFormat::Int16;
+        else
+        {
+            printUsage();
+            return 1;
+        }
+
+        std::vector<double> isoLevels{0.3, 0.4, 0.5};
+        size_t bandRows = 256;
+        size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        size_t scale = 1;
+        std::string outputFormat = "text";
+        for(int i = 6; i + 1 < argc; i += 2)
+        {
+            const std::string option = argv[i];
+            if(option == "--levels") isoLevels = parseLevels(argv[i+1]);
+            else if(option == "--band-rows") bandRows = std::stoull(argv[i+1]);
+            else if(option == "--threads") threadCount = std::stoull(argv[i+1]);
+            else if(option == "--scale") scale = std::stoull(argv[i+1]);
+            else if(option == "--format") outputFormat = argv[i+1];
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+
+        if(outputFormat != "text" && outputFormat != "archive")
+        {
+            printUsage();
+            return 1;
+        }
+
+        MappedRaster raster(rasterPath, width, height, format);
+        const auto contour = [&](ISquaresOutput &output)
+        {
+            StreamingMarchingSquares squares(raster, output, bandRows, scale);
+
+            std::unique_ptr<ThreadPool> threadPool;
+            if(threadCount > 0)
+            {
+                threadPool = std::make_unique<ThreadPool>(threadCount);
+                squares.setThreadPool(threadPool.get());
+            }
+            return squares.run(isoLevels);
+        };
+
+        size_t vertexCount;
+        if(outputFormat == "archive")
+        {
+            ContourArchiveWriter output(outputPath);
+            vertexCount = contour(output);
+            output.close();
+        }
+        else
+        {
+            std::FILE *outputFile = std::fopen(outputPath.c_str(), "w");
+            if(!outputFile)
+                throw std::runtime_error("Unable to open " + outputPath);
+            try
+            {
+                TriangleTextOutput output(outputFile);
+                vertexCount = contour(output);
+                output.finish();
+            }
+            catch(...)
+            {
+                std::fclose(outputFile);
+                throw;
+            }
+            if(std::fclose(outputFile) != 0)
+                throw std::runtime_error("Unable to write " + outputPath);
+        }
+
+        std::cout << "Wrote " << vertexCount / 3 << " triangles to " << outputPath << "\n";
+    }
+    catch(const std::exception &exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,571 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "MarchingSquares.hpp"
+
+//Level of detail stages that sit between MarchingSquares and a real output. MarchingSquares writes a frame into one of these at full resolution
+//and present() hands a simplified copy on to the real output, so the renderer only ever sees as many vertices as can be told apart on screen.
+//
+//Levels are cached per frame. Level 0 is simplified to maxScreenError output units, every level after that to twice the one before, and
+//present(viewScale) picks the coarsest level that still stays within maxScreenError pixels once the output is scaled by viewScale
+//(below 1 when zoomed out). Zoomed in too far for level 0 the frame is passed on untouched.
+class ContourLevelsOfDetail
+{
+    double mMaxScreenError;
+    size_t mLevelCount;
+
+protected:
+    ContourLevelsOfDetail(const double maxScreenError, const size_t levelCount) : mMaxScreenError(maxScreenError), mLevelCount(std::max<size_t>(levelCount, 1)) {}
+
+    //Error allowed at a level, in output units
+    double getTolerance(const size_t level) const
+    {
+        return std::ldexp(mMaxScreenError, static_cast<int>(level));
+    }
+
+    //The level to use at viewScale, or getLevelCount() for full resolution. A viewScale that isn't a positive number gets the coarsest level.
+    size_t selectLevel(const double viewScale) const
+    {
+        if(!(viewScale > 0.0))
+            return mLevelCount - 1;
+        if(viewScale > 1.0 || mMaxScreenError <= 0.0)
+            return mLevelCount;
+        //Clamped before the cast, 1.0 / viewScale is infinite for tiny scales
+        return static_cast<size_t>(std::min(std::floor(std::log2(1.0 / viewScale)), static_cast<double>(mLevelCount - 1)));
+    }
+
+public:
+    size_t getLevelCount() const
+    {
+        return mLevelCount;
+    }
+};
+
+//Douglas-Peucker for MarchingSquares::renderPolylines().
+//Every vertex of a frame is given the largest tolerance it survives at (the error it fixes, capped by the vertex that split its span),
+//which is worked out once per frame. Any level is then a single pass keeping the vertices above its tolerance, and is exactly what running
+//Douglas-Peucker at that tolerance would give. Closed lines that simplify down to fewer than 3 vertices are dropped.
+class SimplifiedPolylineOutput : public ISquaresPolylineOutput, public ContourLevelsOfDetail
+{
+    struct Level
+    {
+        std::vector<std::vector<SquaresVertex>> vertices;   //Per iso level
+        std::vector<std::vector<SquaresPolyline>> polylines;
+        bool valid = false;
+    };
+
+    ISquaresPolylineOutput &mOutput;
+    std::vector<double> mIsoLevels;
+    std::vector<std::vector<SquaresVertex>> mVertices;      //The frame as it was rendered
+    std::vector<std::vector<SquaresPolyline>> mPolylines;
+    std::vector<std::vector<float>> mTolerances;            //Largest tolerance each vertex is kept at
+    std::vector<std::pair<uint32_t, uint32_t>> mSpans;      //Scratch stack of spans still to split
+    std::vector<Level> mLevels;
+
+    static float getSegmentDistance(const SquaresVertex &point, const SquaresVertex &from, const SquaresVertex &to)
+    {
+        const float segmentX = to.x - from.x, segmentY = to.y - from.y;
+        const float lengthSquared = (segmentX * segmentX) + (segmentY * segmentY);
+        float t = 0.0f;
+        if(lengthSquared > 0.0f)
+            t = std::clamp((((point.x - from.x) * segmentX) + ((point.y - from.y) * segmentY)) / lengthSquared, 0.0f, 1.0f);
+        return std::hypot(point.x - (from.x + (t * segmentX)), point.y - (from.y + (t * segmentY)));
+    }
+
+    //Split [first, last] of a line at its furthest vertex over and over, vertices are indices into the line wrapping round for closed lines.
+    void rankSpan(std::span<const SquaresVertex> line, std::span<float> tolerances, const uint32_t first, const uint32_t last)
+    {
+        const auto count = static_cast<uint32_t>(line.size());
+        mSpans.clear();
+        mSpans.emplace_back(first, last);
+        while(!mSpans.empty())
+        {
+            const auto [begin, end] = mSpans.back();
+            mSpans.pop_back();
+            if(end - begin < 2)
+                continue;
+
+            float furthestDistance = -1.0f;
+            uint32_t furthest = begin + 1;
+            for(uint32_t i = begin + 1; i < end; i++)
+            {
+                const float distance = getSegmentDistance(line[i % count], line[begin % count], line[end % count]);
+                if(distance > furthestDistance)
+                {
+                    furthestDistance = distance;
+                    furthest = i;
+                }
+            }
+
+            //A vertex can't outlive the ones either side of its span, they were only kept because something between them mattered.
+            tolerances[furthest % count] = std::min({furthestDistance, tolerances[begin % count], tolerances[end % count]});
+            mSpans.emplace_back(begin, furthest);
+            mSpans.emplace_back(furthest, end);
+        }
+    }
+
+    void rankLine(std::span<const SquaresVertex> line, std::span<float> tolerances, const bool closed)
+    {
+        std::fill(tolerances.begin(), tolerances.end(), 0.0f);
+        if(line.empty())
+            return;
+
+        const auto count = static_cast<uint32_t>(line.size());
+        tolerances[0] = std::numeric_limits<float>::infinity();
+        if(!closed)
+        {
+            tolerances[count - 1] = std::numeric_limits<float>::infinity();
+            rankSpan(line, tolerances, 0, count - 1);
+            return;
+        }
+
+        //Loops are pinned at their first vertex and the vertex furthest from it, then each half is split like an open line.
+        uint32_t opposite = 0;
+        float oppositeDistance = -1.0f;
+        for(uint32_t i = 1; i < count; i++)
+        {
+            const float distance = std::hypot(line[i].x - line[0].x, line[i].y - line[0].y);
+            if(distance > oppositeDistance)
+            {
+                oppositeDistance = distance;
+                opposite = i;
+            }
+        }
+        tolerances[opposite] = oppositeDistance * 0.5f; //A loop smaller than the tolerance disappears
+        rankSpan(line, tolerances, 0, opposite);
+        rankSpan(line, tolerances, opposite, count);
+    }
+
+    void buildLevel(const size_t levelIndex)
+    {
+        auto &level = mLevels[levelIndex];
+        const auto tolerance = static_cast<float>(getTolerance(levelIndex));
+        level.vertices.resize(mIsoLevels.size());
+        level.polylines.resize(mIsoLevels.size());
+        for(size_t isoLevelIndex = 0; isoLevelIndex < mIsoLevels.size(); isoLevelIndex++)
+        {
+            auto &vertices = level.vertices[isoLevelIndex];
+            auto &polylines = level.polylines[isoLevelIndex];
+            vertices.clear();
+            polylines.clear();
+            for(const auto &polyline : mPolylines[isoLevelIndex])
+            {
+                const auto firstVertex = static_cast<uint32_t>(vertices.size());
+                for(uint32_t i = polyline.firstVertex; i < polyline.firstVertex + polyline.vertexCount; i++)
+                    if(mTolerances[isoLevelIndex][i] > tolerance)
+                        vertices.push_back(mVertices[isoLevelIndex][i]);
+
+                const auto vertexCount = static_cast<uint32_t>(vertices.size()) - firstVertex;
+                if(polyline.closed && vertexCount < 3)
+                    vertices.resize(firstVertex);
+                else
+                    polylines.push_back({firstVertex, vertexCount, polyline.closed});
+            }
+        }
+        level.valid = true;
+    }
+
+public:
+    explicit SimplifiedPolylineOutput(ISquaresPolylineOutput &output, double maxScreenError = 1.0, size_t levelCount = 4) : ContourLevelsOfDetail(maxScreenError, levelCount),
+                                                                                                                          mOutput(output), mLevels(getLevelCount())
+    {}
+
+    void resetPolylines(const std::vector<double> &isoLevels) override
+    {
+        mIsoLevels = isoLevels;
+        mVertices.resize(isoLevels.size());
+        mPolylines.resize(isoLevels.size());
+        mTolerances.resize(isoLevels.size());
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            mVertices[isoLevelIndex].clear();
+            mPolylines[isoLevelIndex].clear();
+        }
+        for(auto &level : mLevels)
+            level.valid = false;
+    }
+
+    void addPolylines(size_t isoLevelIndex, std::span<const SquaresVertex> vertices, std::span<const SquaresPolyline> polylines) override
+    {
+        mVertices[isoLevelIndex].assign(vertices.begin(), vertices.end());
+        mPolylines[isoLevelIndex].assign(polylines.begin(), polylines.end());
+        mTolerances[isoLevelIndex].resize(vertices.size());
+        for(const auto &polyline : polylines)
+            rankLine(std::span(mVertices[isoLevelIndex]).subspan(polyline.firstVertex, polyline.vertexCount),
+                     std::span(mTolerances[isoLevelIndex]).subspan(polyline.firstVertex, polyline.vertexCount), polyline.closed);
+    }
+
+    //Pass the current frame on at the right level for viewScale, returns the number of vertices written.
+    size_t present(const double viewScale = 1.0)
+    {
+        const size_t levelIndex = selectLevel(viewScale);
+        if(levelIndex < mLevels.size() && !mLevels[levelIndex].valid)
+            buildLevel(levelIndex);
+
+        const auto &vertices = levelIndex < mLevels.size() ? mLevels[levelIndex].vertices : mVertices;
+        const auto &polylines = levelIndex < mLevels.size() ? mLevels[levelIndex].polylines : mPolylines;
+        size_t vertexCount = 0;
+        mOutput.resetPolylines(mIsoLevels);
+        for(size_t isoLevelIndex = 0; isoLevelIndex < mIsoLevels.size(); isoLevelIndex++)
+        {
+            mOutput.addPolylines(isoLevelIndex, vertices[isoLevelIndex], polylines[isoLevelIndex]);
+            vertexCount += vertices[isoLevelIndex].size();
+        }
+        return vertexCount;
+    }
+};
+
+//Grid snapping decimator for the triangles from render() and renderSinglePass(). Each level lays a grid its tolerance wide over the frame.
+//Cells an iso level covers completely are merged, four at a time where they can be, and drawn as one quad each, so the inside of a filled region
+//costs about as many triangles as its outline. The triangles that reach into any other cell have every vertex snapped to the grid, and the ones
+//that collapse to nothing or land exactly on top of another triangle of the same iso level are dropped.
+//Level 0 passes the frame on as it was rendered, the triangles only shrink from level 1 up. A grid maxScreenError wide is as fine as the pixels,
+//working it out would cost more than drawing the triangles it saves.
+//Snapping moves the edges of the filled regions by up to half a grid cell, so neighbouring levels can overlap or leave slivers at that scale.
+class SnappedTriangleOutput : public ISquaresOutput, public ContourLevelsOfDetail
+{
+    constexpr static size_t MaxCoveredCells = size_t{1} << 26; //Frames that need more cells than this at a level are only snapped
+
+    struct Level
+    {
+        std::vector<SquaresVertex> vertices;
+        std::vector<std::pair<size_t, size_t>> levelRuns; //Iso level index and vertex count of each run of vertices
+        bool valid = false;
+    };
+
+    //Snapped triangle as grid coordinates, only used to spot duplicates.
+    struct SnappedTriangle
+    {
+        std::array<int32_t, 6> coordinates;
+        uint32_t isoLevelIndex;
+
+        bool operator==(const SnappedTriangle &) const = default;
+    };
+
+    struct SnappedTriangleHash
+    {
+        size_t operator()(const SnappedTriangle &triangle) const
+        {
+            uint64_t hash = triangle.isoLevelIndex;
+            for(const auto coordinate : triangle.coordinates)
+                hash = (hash ^ static_cast<uint32_t>(coordinate)) * 0x100000001b3ull;
+            return static_cast<size_t>(hash ^ (hash >> 29));
+        }
+    };
+
+    ISquaresOutput &mOutput;
+    std::vector<double> mIsoLevels;
+    std::vector<SquaresVertex> mVertices;       //The frame as it was rendered
+    std::vector<uint32_t> mVertexIsoLevels;     //Iso level index of every vertex
+    std::vector<Level> mLevels;
+    std::unordered_set<SnappedTriangle, SnappedTriangleHash> mSeenTriangles;
+
+    //Cells of the snapping grid each iso level covers completely. [0] is the grid itself and every size after it has cells twice as wide, covered where
+    //all four cells below are. Indexed by getCellIndex(), sizes in mCoveredCellSizes, cell 0,0 is at mCellOriginX/Y grid steps.
+    std::vector<float> mCellAreas;
+    std::vector<std::vector<uint8_t>> mCoveredCells;
+    std::vector<std::pair<size_t, size_t>> mCoveredCellSizes;
+    int64_t mCellOriginX = 0, mCellOriginY = 0;
+    size_t mCellIsoLevelCount = 0;
+    std::vector<uint8_t> mCoveredCellsAdded;
+
+    size_t getIsoLevelIndex(const double isoLevel)
+    {
+        const auto found = std::find(mIsoLevels.begin(), mIsoLevels.end(), isoLevel);
+        if(found != mIsoLevels.end())
+            return static_cast<size_t>(found - mIsoLevels.begin());
+        mIsoLevels.push_back(isoLevel);
+        return mIsoLevels.size() - 1;
+    }
+
+    //Area of the triangle starting at firstVertex inside the box [minX, maxX] x [minY, maxY]. The triangle is clipped against each side of the box in turn.
+    double getClippedArea(const size_t firstVertex, const double minX, const double minY, const double maxX, const double maxY) const
+    {
+        using Point = std::array<double, 2>;
+        std::array<Point, 8> polygon, clipped; //A triangle clipped by 4 sides has at most 7 corners
+        size_t count = 3;
+        for(size_t corner = 0; corner < 3; corner++)
+            polygon[corner] = {mVertices[firstVertex + corner].x, mVertices[firstVertex + corner].y};
+
+        const std::array<std::tuple<size_t, double, double>, 4> sides{{{0, minX, 1.0}, {0, maxX, -1.0}, {1, minY, 1.0}, {1, maxY, -1.0}}}; //Axis, position, side kept
+        for(const auto &[axis, position, direction] : sides)
+        {
+            if(std::all_of(polygon.begin(), polygon.begin() + static_cast<std::ptrdiff_t>(count), [&](const Point &point) { return (point[axis] - position) * direction >= 0.0; }))
+                continue; //Most triangles are inside most sides
+
+            size_t clippedCount = 0;
+            for(size_t i = 0; i < count; i++)
+            {
+                const Point &from = polygon[i], &to = polygon[(i + 1) % count];
+                const bool fromInside = (from[axis] - position) * direction >= 0.0, toInside = (to[axis] - position) * direction >= 0.0;
+                if(fromInside)
+                    clipped[clippedCount++] = from;
+                if(fromInside != toInside)
+                {
+                    const double t = (position - from[axis]) / (to[axis] - from[axis]);
+                    clipped[clippedCount++] = {from[0] + (t * (to[0] - from[0])), from[1] + (t * (to[1] - from[1]))};
+                }
+            }
+            polygon = clipped;
+            count = clippedCount;
+            if(count < 3)
+                return 0.0;
+        }
+
+        double doubleArea = 0.0;
+        for(size_t i = 0; i < count; i++)
+            doubleArea += (polygon[i][0] * polygon[(i + 1) % count][1]) - (polygon[(i + 1) % count][0] * polygon[i][1]);
+        return std::abs(doubleArea) * 0.5;
+    }
+
+    //Cells of the snapping grid the bounds of the triangle starting at firstVertex overlap, inclusive and relative to mCellOriginX/Y. {minX, minY, maxX, maxY}
+    std::array<int64_t, 4> getCellRange(const size_t firstVertex, const double tolerance) const
+    {
+        const auto [minX, maxX] = std::minmax({mVertices[firstVertex].x, mVertices[firstVertex + 1].x, mVertices[firstVertex + 2].x});
+        const auto [minY, maxY] = std::minmax({mVertices[firstVertex].y, mVertices[firstVertex + 1].y, mVertices[firstVertex + 2].y});
+        const auto cellMinX = static_cast<int64_t>(std::floor(minX / tolerance)), cellMinY = static_cast<int64_t>(std::floor(minY / tolerance));
+        //A triangle that ends exactly on a cell edge doesn't reach into the next cell
+        const auto cellMaxX = std::max(static_cast<int64_t>(std::ceil(maxX / tolerance)) - 1, cellMinX);
+        const auto cellMaxY = std::max(static_cast<int64_t>(std::ceil(maxY / tolerance)) - 1, cellMinY);
+        return {cellMinX - mCellOriginX, cellMinY - mCellOriginY, cellMaxX - mCellOriginX, cellMaxY - mCellOriginY};
+    }
+
+    size_t getCellIndex(const size_t sizeLevel, const size_t isoLevelIndex, const size_t x, const size_t y) const
+    {
+        const auto [width, height] = mCoveredCellSizes[sizeLevel];
+        return (((isoLevelIndex * height) + y) * width) + x;
+    }
+
+    //Fill in mCoveredCells for a grid tolerance wide. Returns false if the frame is too big to keep a cell grid for, then nothing is merged.
+    bool markCoveredCells(const double tolerance)
+    {
+        float minX = std::numeric_limits<float>::max(), minY = minX, maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        mCellIsoLevelCount = 0;
+        for(size_t i = 0; i < mVertices.size(); i++)
+        {
+            minX = std::min(minX, mVertices[i].x);
+            minY = std::min(minY, mVertices[i].y);
+            maxX = std::max(maxX, mVertices[i].x);
+            maxY = std::max(maxY, mVertices[i].y);
+            mCellIsoLevelCount = std::max<size_t>(mCellIsoLevelCount, mVertexIsoLevels[i] + 1);
+        }
+        if(mVertices.size() < 3 || !std::isfinite(minX) || !std::isfinite(minY) || !std::isfinite(maxX) || !std::isfinite(maxY))
+            return false;
+
+        mCellOriginX = static_cast<int64_t>(std::floor(minX / tolerance));
+        mCellOriginY = static_cast<int64_t>(std::floor(minY / tolerance));
+        const auto width = static_cast<size_t>(static_cast<int64_t>(std::ceil(maxX / tolerance)) - mCellOriginX + 1);
+        const auto height = static_cast<size_t>(static_cast<int64_t>(std::ceil(maxY / tolerance)) - mCellOriginY + 1);
+        if(width > MaxCoveredCells / height / mCellIsoLevelCount)
+            return false;
+
+        mCoveredCellSizes.assign(1, {width, height});
+        mCellAreas.assign(width * height * mCellIsoLevelCount, 0.0f);
+        for(size_t i = 0; i + 2 < mVertices.size(); i += 3)
+        {
+            const auto [cellMinX, cellMinY, cellMaxX, cellMaxY] = getCellRange(i, tolerance);
+            for(int64_t y = cellMinY; y <= cellMaxY; y++)
+                for(int64_t x = cellMinX; x <= cellMaxX; x++)
+                {
+                    const double cellX = static_cast<double>(x + mCellOriginX) * tolerance, cellY = static_cast<double>(y + mCellOriginY) * tolerance;
+                    mCellAreas[getCellIndex(0, mVertexIsoLevels[i], static_cast<size_t>(x), static_cast<size_t>(y))] +=
+                        static_cast<float>(getClippedArea(i, cellX, cellY, cellX + tolerance, cellY + tolerance));
+                }
+        }
+
+        //The triangles of one iso level don't overlap, so a cell they add up to the whole of is covered. A little is let off for rounding.
+        const auto coveredArea = static_cast<float>(tolerance * tolerance * 0.999);
+        mCoveredCells.resize(1);
+        mCoveredCells[0].resize(mCellAreas.size());
+        std::transform(mCellAreas.begin(), mCellAreas.end(), mCoveredCells[0].begin(), [coveredArea](const float area) { return area >= coveredArea ? 1 : 0; });
+
+        //Each size up is covered where all four cells below it are, until there's nothing left to merge
+        while(true)
+        {
+            const size_t sizeLevel = mCoveredCells.size() - 1;
+            const auto [belowWidth, belowHeight] = mCoveredCellSizes[sizeLevel];
+            if(belowWidth == 1 && belowHeight == 1)
+                break;
+            mCoveredCellSizes.emplace_back((belowWidth + 1) / 2, (belowHeight + 1) / 2);
+            const auto [aboveWidth, aboveHeight] = mCoveredCellSizes.back();
+            std::vector<uint8_t> above(aboveWidth * aboveHeight * mCellIsoLevelCount, 0);
+            bool anyCovered = false;
+            const auto &below = mCoveredCells[sizeLevel];
+            for(size_t isoLevelIndex = 0; isoLevelIndex < mCellIsoLevelCount; isoLevelIndex++)
+                for(size_t y = 0; y + 1 < belowHeight; y += 2)
+                    for(size_t x = 0; x + 1 < belowWidth; x += 2)
+                    {
+                        const bool covered = below[getCellIndex(sizeLevel, isoLevelIndex, x, y)] && below[getCellIndex(sizeLevel, isoLevelIndex, x + 1, y)] &&
+                                             below[getCellIndex(sizeLevel, isoLevelIndex, x, y + 1)] && below[getCellIndex(sizeLevel, isoLevelIndex, x + 1, y + 1)];
+                        above[(((isoLevelIndex * aboveHeight) + (y / 2)) * aboveWidth) + (x / 2)] = covered ? 1 : 0;
+                        anyCovered = anyCovered || covered;
+                    }
+            if(!anyCovered)
+            {
+                mCoveredCellSizes.pop_back();
+                break;
+            }
+            mCoveredCells.push_back(std::move(above));
+        }
+        return true;
+    }
+
+    void addTriangle(Level &level, const uint32_t isoLevelIndex, const SquaresVertex &a, const SquaresVertex &b, const SquaresVertex &c)
+    {
+        level.vertices.insert(level.vertices.end(), {a, b, c});
+        if(level.levelRuns.empty() || level.levelRuns.back().first != isoLevelIndex)
+            level.levelRuns.emplace_back(isoLevelIndex, 0);
+        level.levelRuns.back().second += 3;
+    }
+
+    //One quad for every covered cell that isn't part of a bigger covered cell
+    void addCoveredCells(Level &level, const uint32_t isoLevelIndex, const double tolerance)
+    {
+        for(size_t sizeLevel = 0; sizeLevel < mCoveredCells.size(); sizeLevel++)
+        {
+            const auto [width, height] = mCoveredCellSizes[sizeLevel];
+            const bool top = sizeLevel + 1 == mCoveredCells.size();
+            for(size_t y = 0; y < height; y++)
+                for(size_t x = 0; x < width; x++)
+                {
+                    if(!mCoveredCells[sizeLevel][getCellIndex(sizeLevel, isoLevelIndex, x, y)] ||
+                       (!top && mCoveredCells[sizeLevel + 1][getCellIndex(sizeLevel + 1, isoLevelIndex, x / 2, y / 2)]))
+                        continue;
+
+                    const auto toPosition = [tolerance](const int64_t cell) { return static_cast<float>(static_cast<double>(cell) * tolerance); };
+                    const float minX = toPosition(mCellOriginX + static_cast<int64_t>(x << sizeLevel)), maxX = toPosition(mCellOriginX + static_cast<int64_t>((x + 1) << sizeLevel));
+                    const float minY = toPosition(mCellOriginY + static_cast<int64_t>(y << sizeLevel)), maxY = toPosition(mCellOriginY + static_cast<int64_t>((y + 1) << sizeLevel));
+                    addTriangle(level, isoLevelIndex, {minX, minY}, {maxX, minY}, {maxX, maxY});
+                    addTriangle(level, isoLevelIndex, {minX, minY}, {maxX, maxY}, {minX, maxY});
+                }
+        }
+    }
+
+    bool isInCoveredCells(const size_t firstVertex, const double tolerance) const
+    {
+        const auto [cellMinX, cellMinY, cellMaxX, cellMaxY] = getCellRange(firstVertex, tolerance);
+        for(int64_t y = cellMinY; y <= cellMaxY; y++)
+            for(int64_t x = cellMinX; x <= cellMaxX; x++)
+                if(!mCoveredCells[0][getCellIndex(0, mVertexIsoLevels[firstVertex], static_cast<size_t>(x), static_cast<size_t>(y))])
+                    return false;
+        return true;
+    }
+
+    void buildLevel(const size_t levelIndex)
+    {
+        auto &level = mLevels[levelIndex];
+        const double tolerance = getTolerance(levelIndex);
+        level.vertices.clear();
+        level.levelRuns.clear();
+        mSeenTriangles.clear();
+        const bool merge = markCoveredCells(tolerance);
+        mCoveredCellsAdded.assign(mCellIsoLevelCount, 0);
+
+        for(size_t i = 0; i + 2 < mVertices.size(); i += 3)
+        {
+            const uint32_t isoLevelIndex = mVertexIsoLevels[i];
+            if(merge)
+            {
+                if(!mCoveredCellsAdded[isoLevelIndex]) //Before the iso level's first triangle, so the levels still draw in order
+                {
+                    addCoveredCells(level, isoLevelIndex, tolerance);
+                    mCoveredCellsAdded[isoLevelIndex] = 1;
+                }
+                if(isInCoveredCells(i, tolerance))
+                    continue;
+            }
+
+            SnappedTriangle triangle{{}, isoLevelIndex};
+            for(size_t corner = 0; corner < 3; corner++)
+            {
+                triangle.coordinates[corner * 2] = static_cast<int32_t>(std::lround(mVertices[i + corner].x / tolerance));
+                triangle.coordinates[(corner * 2) + 1] = static_cast<int32_t>(std::lround(mVertices[i + corner].y / tolerance));
+            }
+
+            const auto &c = triangle.coordinates;
+            const int64_t doubleArea = (static_cast<int64_t>(c[2] - c[0]) * (c[5] - c[1])) - (static_cast<int64_t>(c[4] - c[0]) * (c[3] - c[1]));
+            if(doubleArea == 0 || !mSeenTriangles.insert(triangle).second)
+                continue;
+
+            const auto toVertex = [tolerance, &c](const size_t corner) -> SquaresVertex
+            {
+                return {static_cast<float>(c[corner * 2] * tolerance), static_cast<float>(c[(corner * 2) + 1] * tolerance)};
+            };
+            addTriangle(level, isoLevelIndex, toVertex(0), toVertex(1), toVertex(2));
+        }
+        level.valid = true;
+    }
+
+public:
+    explicit SnappedTriangleOutput(ISquaresOutput &output, double maxScreenError = 1.0, size_t levelCount = 4) : ContourLevelsOfDetail(maxScreenError, levelCount),
+                                                                                                               mOutput(output), mLevels(getLevelCount())
+    {}
+
+    void resetVertices(size_t vertexCount) override
+    {
+        mVertices.resize(vertexCount);
+        mVertexIsoLevels.resize(vertexCount);
+        for(auto &level : mLevels)
+            level.valid = false;
+    }
+
+    void addVertex(double isoLevel, double x, double y) override
+    {
+        mVertices.push_back({static_cast<float>(x), static_cast<float>(y)});
+        mVertexIsoLevels.push_back(static_cast<uint32_t>(getIsoLevelIndex(isoLevel)));
+    }
+
+    void setVertex(size_t vertexIndex, double x, double y) override
+    {
+        mVertices[vertexIndex] = {static_cast<float>(x), static_cast<float>(y)};
+    }
+
+    void setIsoLevels(const std::vector<double> &isoLevels) override
+    {
+        mIsoLevels = isoLevels;
+    }
+
+    void writeVertices(size_t firstVertex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override //Safe to call from several threads, like the real thing
+    {
+        std::copy(vertices.begin(), vertices.end(), mVertices.begin() + static_cast<std::ptrdiff_t>(firstVertex));
+        std::fill_n(mVertexIsoLevels.begin() + static_cast<std::ptrdiff_t>(firstVertex), vertices.size(), static_cast<uint32_t>(isoLevelIndex));
+    }
+
+    //Pass the current frame on at the right level for viewScale, returns the number of vertices written.
+    size_t present(const double viewScale = 1.0)
+    {
+        mOutput.setIsoLevels(mIsoLevels);
+        const size_t levelIndex = selectLevel(viewScale);
+        if(levelIndex == 0 || levelIndex >= mLevels.size())
+        {
+            mOutput.resetVertices(mVertices.size());
+            for(size_t first = 0, last = 0; first < mVertices.size(); first = last) //One write per run of the same iso level
+            {
+                for(last = first + 1; last < mVertices.size() && mVertexIsoLevels[last] == mVertexIsoLevels[first]; last++) {}
+                mOutput.writeVertices(first, mVertexIsoLevels[first], std::span(mVertices).subspan(first, last - first));
+            }
+            return mVertices.size();
+        }
+
+        auto &level = mLevels[levelIndex];
+        if(!level.valid)
+            buildLevel(levelIndex);
+
+        mOutput.resetVertices(level.vertices.size());
+        size_t firstVertex = 0;
+        for(const auto &[isoLevelIndex, vertexCount] : level.levelRuns)
+        {
+            mOutput.writeVertices(firstVertex, isoLevelIndex, std::span(level.vertices).subspan(firstVertex, vertexCount));
+            firstVertex += vertexCount;
+        }
+        return firstVertex;
+    }
+};
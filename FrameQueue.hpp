@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//Lock-free handoff of finished frames from the workers to the render loop.
+//Every slot has a frame of its own, so workers only ever write to slots the renderer isn't showing and never wait on it. Frames are numbered in the
+//order they're started. A worker publishes a slot by storing the number of the frame in it, and acquire() takes the newest published frame that's newer
+//than the one on screen without waiting. The slot that was on screen and any older finished slots (frames the renderer was too slow to show) go straight
+//back to startFrame with the next number, so a slow frame only holds up its own slot and frames are always shown in order.
+template<typename Frame>
+class FrameQueue
+{
+public:
+    //Called on the render thread to start work on a frame. The work must end with publish(slotIndex).
+    using StartFrameFunction = std::function<void(Frame &frame, uint64_t sequence, size_t slotIndex)>;
+
+private:
+    constexpr static uint64_t NotReady = std::numeric_limits<uint64_t>::max();
+
+    struct Slot
+    {
+        std::unique_ptr<Frame> frame;
+        std::atomic<uint64_t> readySequence{NotReady}; //Written by the worker, read by the renderer
+        uint64_t sequence = 0;                          //Only used by the renderer
+    };
+
+    std::vector<std::unique_ptr<Slot>> mSlots;
+    StartFrameFunction mStartFrame;
+    uint64_t mNextSequence = 0;
+    size_t mDisplayedSlot = NoSlot;
+    uint64_t mSkippedFrames = 0;
+
+    void restart(const size_t slotIndex)
+    {
+        auto &slot = *mSlots[slotIndex];
+        slot.readySequence.store(NotReady, std::memory_order_relaxed); //Nobody else touches the slot until it's started again
+        slot.sequence = mNextSequence++;
+        mStartFrame(*slot.frame, slot.sequence, slotIndex);
+    }
+
+public:
+    constexpr static size_t NoSlot = std::numeric_limits<size_t>::max();
+
+    size_t addSlot(std::unique_ptr<Frame> frame)
+    {
+        auto &slot = *mSlots.emplace_back(std::make_unique<Slot>());
+        slot.frame = std::move(frame);
+        return mSlots.size() - 1;
+    }
+
+    //Start every slot on its first frame.
+    void start(StartFrameFunction startFrame)
+    {
+        mStartFrame = std::move(startFrame);
+        for(size_t slotIndex = 0; slotIndex < mSlots.size(); slotIndex++)
+            restart(slotIndex);
+    }
+
+    //Worker side, the frame in slotIndex is finished. Release ordering makes everything written to the frame visible to acquire().
+    void publish(const size_t slotIndex)
+    {
+        auto &slot = *mSlots[slotIndex];
+        slot.readySequence.store(slot.sequence, std::memory_order_release);
+    }
+
+    //Render thread side. Returns the newest finished frame, which is the one already on screen if nothing newer is ready, or nullptr before the first frame.
+    //The frame stays valid until the next acquire().
+    Frame *acquire()
+    {
+        const uint64_t displayedSequence = (mDisplayedSlot == NoSlot) ? NotReady : mSlots[mDisplayedSlot]->sequence;
+        size_t newestSlot = NoSlot;
+        for(size_t slotIndex = 0; slotIndex < mSlots.size(); slotIndex++)
+        {
+            const uint64_t readySequence = mSlots[slotIndex]->readySequence.load(std::memory_order_acquire);
+            if(readySequence == NotReady || slotIndex == mDisplayedSlot)
+                continue;
+            if(displayedSequence != NotReady && readySequence < displayedSequence) //Finished after a newer frame was already shown
+            {
+                mSkippedFrames++;
+                restart(slotIndex);
+                continue;
+            }
+            if(newestSlot == NoSlot || readySequence > mSlots[newestSlot]->sequence)
+                newestSlot = slotIndex;
+        }
+        if(newestSlot == NoSlot)
+            return mDisplayedSlot == NoSlot ? nullptr : mSlots[mDisplayedSlot]->frame.get();
+
+        //Everything finished before the new frame won't be shown now, put those slots back to work
+        const uint64_t newestSequence = mSlots[newestSlot]->sequence;
+        const size_t previousSlot = mDisplayedSlot;
+        mDisplayedSlot = newestSlot;
+        if(previousSlot != NoSlot)
+            restart(previousSlot);
+        for(size_t slotIndex = 0; slotIndex < mSlots.size(); slotIndex++)
+        {
+            const uint64_t readySequence = mSlots[slotIndex]->readySequence.load(std::memory_order_acquire);
+            if(slotIndex != mDisplayedSlot && slotIndex != previousSlot && readySequence != NotReady && readySequence < newestSequence)
+            {
+                mSkippedFrames++;
+                restart(slotIndex);
+            }
+        }
+        return mSlots[mDisplayedSlot]->frame.get();
+    }
+
+    //Frame number of the frame acquire() last returned.
+    uint64_t getDisplayedSequence() const
+    {
+        return mDisplayedSlot == NoSlot ? 0 : mSlots[mDisplayedSlot]->sequence;
+    }
+
+    //Frames that finished but were overtaken by a newer one before they could be shown.
+    uint64_t getSkippedFrames() const
+    {
+        return mSkippedFrames;
+    }
+
+    //e.g. to wait for the frames still being worked on before shutting down.
+    template<typename FrameFunction>
+    void forEachFrame(FrameFunction &&frameFunction)
+    {
+        for(auto &slot : mSlots)
+            frameFunction(*slot->frame);
+    }
+};
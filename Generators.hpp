@@ -0,0 +1,645 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+//https://github.com/Reputeless/PerlinNoise
+#include "PerlinNoise.hpp"
+#include "LangstonsAnt.hpp"
+#include "MarchingSquares.hpp"
+
+class [[maybe_unused]] PerlinHeightmapGenerator : public ISquaresGenerator
+{
+    const siv::PerlinNoise mPerlin;     //Noise generator
+    double mOffsetX, mOffsetY, mOffsetZ;//Noise offsets
+    size_t mResolutionX, mResolutionY;  //Total points x/y probably not the best variable names for this, but whatever.
+public:
+    //Init the seed the perlin generator and initialize member variables.
+    PerlinHeightmapGenerator(size_t resolutionX, size_t resolutionY, size_t seed) : mPerlin(seed), mOffsetX(0.0), mOffsetY(0.0), mOffsetZ(1.0), mResolutionX(resolutionX), mResolutionY(resolutionY)
+    {}
+
+    double getPoint(size_t x, size_t y) override//Get the perlin noise for a point
+    {
+        return mPerlin.accumulatedOctaveNoise3D_0_1(static_cast<double>(x / (mResolutionX / 2.0)) + mOffsetX,
+                                                    static_cast<double>(y / (mResolutionY / 2.0)) + mOffsetY,
+                                                    mOffsetZ, 4);
+    }
+
+    void getRow(size_t x, size_t y, std::span<double> points) override //Feed the batched noise a chunk of the row at a time
+    {
+        constexpr size_t ChunkSize = 64;
+        std::array<double, ChunkSize> noiseX{}, noiseY{}, noiseZ{};
+        noiseY.fill(static_cast<double>(y / (mResolutionY / 2.0)) + mOffsetY); //The y and z coordinates are the same for the whole row
+        noiseZ.fill(mOffsetZ);
+
+        for(size_t start = 0; start < points.size(); start += ChunkSize)
+        {
+            const size_t count = std::min(ChunkSize, points.size() - start);
+            for(size_t i = 0; i < count; i++)
+                noiseX[i] = static_cast<double>((x + start + i) / (mResolutionX / 2.0)) + mOffsetX;
+
+            mPerlin.accumulatedOctaveNoise3D_0_1(noiseX.data(), noiseY.data(), noiseZ.data(), 4, points.data() + start, count);
+        }
+    }
+
+    //step is a nice helper function to have so swapping out point generators is a bit easier.
+    void step(const double delta)
+    {
+        mOffsetZ += delta;
+    }
+
+    void setOffsets(double x, double y, double z) //Set the offset the perlin landscape position
+    {
+        mOffsetX = x;
+        mOffsetY = y;
+        mOffsetZ = z;
+    }
+
+    void moveOffsets(double x, double y, double z) //Move the offset the perlin landscape position
+    {
+        mOffsetX += x;
+        mOffsetY += y;
+        mOffsetZ += z;
+    }
+
+    void setResolution(size_t x, size_t y)  //Change the resolution of the perlin noise (higher numbers will "zoom in")
+    {
+        mResolutionX = x;
+        mResolutionY = y;
+    }
+};
+
+class MetaBallsGenerator : public ISquaresGenerator
+{
+    size_t mResolutionX, mResolutionY;
+    //CenterX CenterY VelocityX, VelocityY Radius
+    std::vector<std::tuple<double, double, double, double, double>> mMetaBalls;
+
+    //Culling, only used with an influence cutoff. The grid is split into tiles and each tile lists the balls that reach it,
+    //so a point only sums the balls near it instead of all of them.
+    constexpr static size_t TileSize = 16;      //Points per tile side
+    double mInfluenceCutoff = 0.0;              //0 sums every ball everywhere
+    size_t mTileCountX = 0, mTileCountY = 0;
+    std::vector<uint32_t> mTileBallStart;       //Balls of tile i are mTileBalls[mTileBallStart[i]] to mTileBalls[mTileBallStart[i+1]]
+    std::vector<uint32_t> mTileBalls;
+    std::vector<uint8_t> mDirtyTiles;           //Tiles changed by step() since getDirtyRects() was last called
+
+    constexpr static double Strength = 0.3;
+
+    //Distance at which a ball's value drops to the cutoff
+    double getInfluenceRadius(const double radius) const
+    {
+        return radius * std::sqrt(Strength / mInfluenceCutoff);
+    }
+
+    //The points a ball reaches, clamped to the grid. Empty (width or height 0) if it's completely outside.
+    SquaresRect getInfluenceRect(const double posX, const double posY, const double radius) const
+    {
+        const double influenceRadius = getInfluenceRadius(radius);
+        const auto clampToGrid = [](const double value, const size_t resolution) { return static_cast<size_t>(std::clamp(value, 0.0, static_cast<double>(resolution))); };
+        const size_t beginX = clampToGrid(std::ceil(posX - influenceRadius), mResolutionX), endX = clampToGrid(std::floor(posX + influenceRadius) + 1.0, mResolutionX);
+        const size_t beginY = clampToGrid(std::ceil(posY - influenceRadius), mResolutionY), endY = clampToGrid(std::floor(posY + influenceRadius) + 1.0, mResolutionY);
+        return {beginX, beginY, endX - beginX, endY - beginY};
+    }
+
+    //Counting sort of the balls into the tiles they reach.
+    void binBalls()
+    {
+        if(mInfluenceCutoff <= 0.0)
+            return;
+
+        mTileCountX = (mResolutionX + TileSize - 1) / TileSize;
+        mTileCountY = (mResolutionY + TileSize - 1) / TileSize;
+        mTileBallStart.assign((mTileCountX * mTileCountY) + 1, 0);
+        mDirtyTiles.resize(mTileCountX * mTileCountY);
+
+        forEachBallTile([this](const size_t tileIndex, uint32_t) { mTileBallStart[tileIndex + 1]++; });
+        for(size_t i = 1; i < mTileBallStart.size(); i++)
+            mTileBallStart[i] += mTileBallStart[i-1];
+
+        mTileBalls.resize(mTileBallStart.back());
+        std::vector<uint32_t> nextSlot(mTileBallStart.begin(), mTileBallStart.end() - 1);
+        forEachBallTile([this, &nextSlot](const size_t tileIndex, const uint32_t ballIndex) { mTileBalls[nextSlot[tileIndex]++] = ballIndex; });
+    }
+
+    //Calls tileFunction(tileIndex, ballIndex) for every tile every ball reaches.
+    template<typename TileFunction>
+    void forEachBallTile(TileFunction &&tileFunction) const
+    {
+        for(uint32_t ballIndex = 0; ballIndex < mMetaBalls.size(); ballIndex++)
+        {
+            const auto &[posX, posY, velX, velY, radius] = mMetaBalls[ballIndex];
+            const auto rect = getInfluenceRect(posX, posY, radius);
+            if(rect.width == 0 || rect.height == 0)
+                continue;
+
+            for(size_t tileY = rect.y / TileSize; tileY <= (rect.y + rect.height - 1) / TileSize; tileY++)
+                for(size_t tileX = rect.x / TileSize; tileX <= (rect.x + rect.width - 1) / TileSize; tileX++)
+                    tileFunction((tileY * mTileCountX) + tileX, ballIndex);
+        }
+    }
+
+    //Add the balls of one tile to points [beginX, endX) of row y, points[0] being point beginX.
+    void addTileRow(const size_t tileIndex, const size_t beginX, const size_t endX, const size_t y, double *points) const
+    {
+        for(uint32_t slot = mTileBallStart[tileIndex]; slot < mTileBallStart[tileIndex + 1]; slot++)
+        {
+            const auto &[posX, posY, velX, velY, radius] = mMetaBalls[mTileBalls[slot]];
+            const double influenceRadius = getInfluenceRadius(radius);
+            const double distanceY = static_cast<double>(y) - posY;
+            const double halfWidthSquared = (influenceRadius * influenceRadius) - (distanceY * distanceY);
+            if(halfWidthSquared <= 0.0)
+                continue;
+
+            //Only the part of the row inside the ball's cutoff circle
+            const double halfWidth = std::sqrt(halfWidthSquared);
+            const auto rowBeginX = std::max(beginX, static_cast<size_t>(std::max(std::ceil(posX - halfWidth), 0.0)));
+            const auto rowEndX = std::min(endX, static_cast<size_t>(std::max(std::floor(posX + halfWidth) + 1.0, 0.0)));
+
+            const double strength = Strength * radius * radius;
+            const double distanceYSquared = distanceY * distanceY;
+            const double cutoff = mInfluenceCutoff;
+            for(size_t x = rowBeginX; x < rowEndX; x++) //No branches or calls, so this vectorizes
+            {
+                const double distanceX = static_cast<double>(x) - posX;
+                points[x - beginX] += std::max((strength / ((distanceX * distanceX) + distanceYSquared)) - cutoff, 0.0);
+            }
+        }
+    }
+
+    //Collisions, off by default since balls bouncing off each other stops them merging into blobs.
+    //Balls are sorted into a grid of cells at least one ball diameter wide, so a ball only has to be tested against the balls
+    //in its own and neighbouring cells instead of every other ball.
+    bool mCollisions = false;
+    double mCollisionCellSize = 1.0;
+    size_t mCollisionCellCountX = 0, mCollisionCellCountY = 0;
+    std::vector<uint32_t> mCollisionCellStart;  //Same layout as the tile bins
+    std::vector<uint32_t> mCollisionCellBalls;
+
+    //Where a ball bouncing between low and high ends up after delta, without stepping through every bounce.
+    //Unfolded the ball moves in a straight line, every 2*(high-low) it's back where it started heading the same way.
+    static void reflectAxis(double &position, double &velocity, const double low, const double high, const double delta)
+    {
+        const double length = high - low;
+        if(length <= 0.0) //Wider than the grid, nowhere to go
+        {
+            position = (low + high) * 0.5;
+            return;
+        }
+
+        const double period = 2.0 * length;
+        double offset = std::fmod(std::clamp(position, low, high) - low + (velocity * delta), period);
+        if(offset < 0.0)
+            offset += period;
+
+        if(offset <= length)
+            position = low + offset;
+        else //On the way back
+        {
+            position = high - (offset - length);
+            velocity = -velocity;
+        }
+    }
+
+    void updatePositions(double delta)
+    {
+        for(auto &metaball : mMetaBalls)
+        {
+            auto &[posX, posY, velX, velY, radius] = metaball; //What an awesome way to tie variables to a tuple.
+
+            //Balls bounce off the walls when their edge hits them
+            reflectAxis(posX, velX, radius, static_cast<double>(mResolutionX) - radius, delta);
+            reflectAxis(posY, velY, radius, static_cast<double>(mResolutionY) - radius, delta);
+        }
+    }
+
+    //Longest step where two balls can't pass through each other, neither can move more than half the smallest radius.
+    double getCollisionStep() const
+    {
+        double maxSpeed = 0.0, minRadius = std::numeric_limits<double>::max();
+        for(const auto &[posX, posY, velX, velY, radius] : mMetaBalls)
+        {
+            maxSpeed = std::max(maxSpeed, std::hypot(velX, velY));
+            minRadius = std::min(minRadius, radius);
+        }
+        return maxSpeed > 0.0 ? (minRadius * 0.5) / maxSpeed : std::numeric_limits<double>::max();
+    }
+
+    void binCollisionCells()
+    {
+        double maxRadius = 0.0;
+        for(const auto &[posX, posY, velX, velY, radius] : mMetaBalls)
+            maxRadius = std::max(maxRadius, radius);
+
+        mCollisionCellSize = std::max(maxRadius * 2.0, 1.0);
+        mCollisionCellCountX = static_cast<size_t>(static_cast<double>(mResolutionX) / mCollisionCellSize) + 1;
+        mCollisionCellCountY = static_cast<size_t>(static_cast<double>(mResolutionY) / mCollisionCellSize) + 1;
+        mCollisionCellStart.assign((mCollisionCellCountX * mCollisionCellCountY) + 1, 0);
+
+        for(const auto &[posX, posY, velX, velY, radius] : mMetaBalls)
+            mCollisionCellStart[getCollisionCell(posX, posY) + 1]++;
+        for(size_t i = 1; i < mCollisionCellStart.size(); i++)
+            mCollisionCellStart[i] += mCollisionCellStart[i-1];
+
+        mCollisionCellBalls.resize(mMetaBalls.size());
+        std::vector<uint32_t> nextSlot(mCollisionCellStart.begin(), mCollisionCellStart.end() - 1);
+        for(uint32_t ballIndex = 0; ballIndex < mMetaBalls.size(); ballIndex++)
+        {
+            const auto &[posX, posY, velX, velY, radius] = mMetaBalls[ballIndex];
+            mCollisionCellBalls[nextSlot[getCollisionCell(posX, posY)]++] = ballIndex;
+        }
+    }
+
+    size_t getCollisionCell(const double posX, const double posY) const
+    {
+        const auto cellX = std::min(static_cast<size_t>(std::max(posX, 0.0) / mCollisionCellSize), mCollisionCellCountX - 1);
+        const auto cellY = std::min(static_cast<size_t>(std::max(posY, 0.0) / mCollisionCellSize), mCollisionCellCountY - 1);
+        return (cellY * mCollisionCellCountX) + cellX;
+    }
+
+    //Elastic collision between overlapping balls that are moving towards each other, heavier (bigger) balls get pushed around less.
+    void collide(const uint32_t firstIndex, const uint32_t secondIndex)
+    {
+        auto &[firstX, firstY, firstVelX, firstVelY, firstRadius] = mMetaBalls[firstIndex];
+        auto &[secondX, secondY, secondVelX, secondVelY, secondRadius] = mMetaBalls[secondIndex];
+
+        const double distanceX = secondX - firstX, distanceY = secondY - firstY;
+        const double distanceSquared = (distanceX * distanceX) + (distanceY * distanceY);
+        const double touchingDistance = firstRadius + secondRadius;
+        if(distanceSquared >= touchingDistance * touchingDistance || distanceSquared == 0.0)
+            return;
+
+        const double distance = std::sqrt(distanceSquared);
+        const double normalX = distanceX / distance, normalY = distanceY / distance;
+        const double approachSpeed = ((firstVelX - secondVelX) * normalX) + ((firstVelY - secondVelY) * normalY);
+        if(approachSpeed <= 0.0) //Already separating
+            return;
+
+        const double firstMass = firstRadius * firstRadius, secondMass = secondRadius * secondRadius;
+        const double firstImpulse = (2.0 * secondMass / (firstMass + secondMass)) * approachSpeed;
+        const double secondImpulse = (2.0 * firstMass / (firstMass + secondMass)) * approachSpeed;
+        firstVelX -= firstImpulse * normalX;
+        firstVelY -= firstImpulse * normalY;
+        secondVelX += secondImpulse * normalX;
+        secondVelY += secondImpulse * normalY;
+    }
+
+    void resolveCollisions()
+    {
+        binCollisionCells();
+        for(size_t cellY = 0; cellY < mCollisionCellCountY; cellY++)
+        {
+            for(size_t cellX = 0; cellX < mCollisionCellCountX; cellX++)
+            {
+                const size_t cellIndex = (cellY * mCollisionCellCountX) + cellX;
+                for(uint32_t slot = mCollisionCellStart[cellIndex]; slot < mCollisionCellStart[cellIndex + 1]; slot++)
+                {
+                    const uint32_t ballIndex = mCollisionCellBalls[slot];
+
+                    //Later balls in the same cell, then the cells right, below left, below and below right. Every pair gets tested once.
+                    for(uint32_t otherSlot = slot + 1; otherSlot < mCollisionCellStart[cellIndex + 1]; otherSlot++)
+                        collide(ballIndex, mCollisionCellBalls[otherSlot]);
+
+                    constexpr std::array<std::pair<int, int>, 4> Neighbours{{{1, 0}, {-1, 1}, {0, 1}, {1, 1}}};
+                    for(const auto &[offsetX, offsetY] : Neighbours)
+                    {
+                        const size_t otherX = cellX + offsetX, otherY = cellY + offsetY; //Wraps around to huge values when going left of 0
+                        if(otherX >= mCollisionCellCountX || otherY >= mCollisionCellCountY)
+                            continue;
+
+                        const size_t otherIndex = (otherY * mCollisionCellCountX) + otherX;
+                        for(uint32_t otherSlot = mCollisionCellStart[otherIndex]; otherSlot < mCollisionCellStart[otherIndex + 1]; otherSlot++)
+                            collide(ballIndex, mCollisionCellBalls[otherSlot]);
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    //ballCount and maxRadius of 0 pick a random number of balls (2-10) with radii up to 15% of the width.
+    //Lots of balls need much smaller radii, and an influence cutoff to keep the cost down.
+    MetaBallsGenerator(size_t resolutionX, size_t resolutionY, size_t seed, size_t ballCount = 0, double maxRadius = 0.0) : mResolutionX(resolutionX), mResolutionY(resolutionY)
+    {
+        //Random balls with random sizes with random directions
+        std::default_random_engine generator(seed);
+        std::uniform_int_distribution<int> ballCountDist(2, 10);
+        std::uniform_real_distribution<double> radiusDist(2, maxRadius > 2.0 ? maxRadius : resolutionX * 0.15); //Based on percentage of total points so sizes are consistent.
+                                                                                                                //(kind of, since it's not relative to window size).
+        for(int i = ballCount > 0 ? static_cast<int>(ballCount) : ballCountDist(generator); i > 0; i--)
+        {
+            double radius = radiusDist(generator);
+
+            std::uniform_real_distribution<double> posXDist(radius + 1.0, resolutionX - radius - 1.0); //At least try not to spawn balls in the walls.
+            std::uniform_real_distribution<double> posYDist(radius + 1.0, resolutionY - radius - 1.0);
+            std::uniform_real_distribution<double> speedDistX(-(resolutionX * 2.0), resolutionX * 2.0); //Not too fast, based on a percentage of total points
+            std::uniform_real_distribution<double> speedDistY(-(resolutionY * 2.0), resolutionY * 2.0); //so speed is always consistent. (kind of, since it's not
+                                                                                                        //relative to window size).
+
+             mMetaBalls.emplace_back(std::make_tuple(posXDist(generator), posYDist(generator), speedDistX(generator), speedDistY(generator), radius));
+        }
+    }
+
+    //Ignore a ball wherever its value would be below cutoff. Each ball's value is lowered by cutoff so it fades out to exactly 0 at the edge
+    //instead of leaving a step in the field, everything else is slightly lower than without a cutoff. 0 (the default) sums every ball at every point.
+    //With a cutoff points only sum the balls that reach them, and step() can report which points changed.
+    void setInfluenceCutoff(const double cutoff)
+    {
+        mInfluenceCutoff = std::max(cutoff, 0.0);
+        binBalls();
+        std::fill(mDirtyTiles.begin(), mDirtyTiles.end(), 1); //Every value changes
+    }
+
+    //Balls bounce off each other as well as the walls.
+    void setCollisions(const bool collisions)
+    {
+        mCollisions = collisions;
+    }
+
+    double getPoint(size_t x, size_t y) override
+    {
+        if(mInfluenceCutoff > 0.0)
+        {
+            double point = 0.0;
+            addTileRow(((y / TileSize) * mTileCountX) + (x / TileSize), x, x + 1, y, &point);
+            return point;
+        }
+
+        double ret = 0.0;
+        for(auto &metaball : mMetaBalls)
+        {
+            auto &[posX, posY, velX, velY, radius] = metaball;
+
+            //define our circle in a way that as the distance from the center increases, the returned value is smaller.
+            //This makes the "blobiness" effect instead of well defined boundaries.
+            ret += ((radius*radius) / (((static_cast<double>(x) - posX) * (static_cast<double>(x) - posX)) + ((static_cast<double>(y) - posY) * (static_cast<double>(y) - posY)))) * Strength;
+
+        }
+        return ret;
+    }
+
+    void getRow(size_t x, size_t y, std::span<double> points) override
+    {
+        std::fill(points.begin(), points.end(), 0.0);
+        if(mInfluenceCutoff > 0.0)
+        {
+            //Tile by tile along the row, each tile only adds the balls binned into it.
+            const size_t tileRowStart = (y / TileSize) * mTileCountX;
+            for(size_t beginX = x; beginX < x + points.size(); )
+            {
+                const size_t endX = std::min(((beginX / TileSize) + 1) * TileSize, x + points.size());
+                addTileRow(tileRowStart + (beginX / TileSize), beginX, endX, y, points.data() + (beginX - x));
+                beginX = endX;
+            }
+            return;
+        }
+
+        //Same sum as getPoint, but one ball at a time across the whole row so the inner loop can be vectorized.
+        for(auto &metaball : mMetaBalls)
+        {
+            auto &[posX, posY, velX, velY, radius] = metaball;
+
+            const double radiusSquared = radius*radius;
+            const double distanceYSquared = (static_cast<double>(y) - posY) * (static_cast<double>(y) - posY);
+            for(size_t i = 0; i < points.size(); i++)
+            {
+                const double distanceX = static_cast<double>(x + i) - posX;
+                points[i] += (radiusSquared / ((distanceX * distanceX) + distanceYSquared)) * Strength;
+            }
+        }
+    }
+
+    //Only known with an influence cutoff, otherwise every point changes every step.
+    bool getDirtyRects(std::vector<SquaresRect> &dirtyRects) override
+    {
+        if(mInfluenceCutoff <= 0.0)
+            return false;
+
+        //Runs of dirty tiles along each tile row, so overlapping balls don't get the same points regenerated over and over.
+        for(size_t tileY = 0; tileY < mTileCountY; tileY++)
+        {
+            for(size_t tileX = 0; tileX < mTileCountX; tileX++)
+            {
+                if(!mDirtyTiles[(tileY * mTileCountX) + tileX])
+                    continue;
+
+                const size_t beginX = tileX;
+                while(tileX < mTileCountX && mDirtyTiles[(tileY * mTileCountX) + tileX])
+                    tileX++;
+
+                const size_t x = beginX * TileSize, y = tileY * TileSize;
+                dirtyRects.push_back({x, y, std::min(tileX * TileSize, mResolutionX) - x, std::min(y + TileSize, mResolutionY) - y});
+            }
+        }
+        std::fill(mDirtyTiles.begin(), mDirtyTiles.end(), 0);
+        return true;
+    }
+
+    void step(double delta)
+    {
+        //Each ball only changes the tiles it reaches before and after moving.
+        const auto markDirtyTiles = [this]()
+        {
+            if(mInfluenceCutoff > 0.0)
+                forEachBallTile([this](const size_t tileIndex, uint32_t) { mDirtyTiles[tileIndex] = 1; });
+        };
+        markDirtyTiles();
+
+        //Without collisions every ball goes straight to where it is after delta, however far that is.
+        //Collisions can only be caught a short step at a time, so that's bounded by how fast the balls move rather than a fixed substep.
+        if(!mCollisions)
+            updatePositions(delta);
+        else
+        {
+            while(delta > 0.0)
+            {
+                const double substep = std::min(delta, getCollisionStep());
+                updatePositions(substep);
+                resolveCollisions();
+                delta -= substep;
+            }
+        }
+
+        markDirtyTiles();
+        binBalls();
+    }
+};
+
+//Turmites (see LangstonsAnt.hpp) on a board with a cell for every point. A point is its cell's colour scaled to 0-1, or with a blur radius
+//the average of the cells around it, which gives rounder contours than following the edges of the cells.
+//Only the points around cells that changed colour are reported dirty, so update() only re-marches around the ants.
+class TurmiteGenerator : public ISquaresGenerator
+{
+    constexpr static double StepsPerSecond = 100000.0; //step() takes seconds like the other generators
+    Turmites mTurmites;
+    size_t mBlurRadius;
+    double mColourScale;
+    double mPendingSteps = 0.0;
+    std::vector<size_t> mChangedCells;
+
+    static size_t wrap(const long position, const size_t size)
+    {
+        const long wrapped = position % static_cast<long>(size);
+        return static_cast<size_t>(wrapped < 0 ? wrapped + static_cast<long>(size) : wrapped);
+    }
+
+    //Sum of the column of cells around x/y
+    double getColumnSum(const size_t x, const size_t y) const
+    {
+        const long radius = static_cast<long>(mBlurRadius);
+        double sum = 0.0;
+        for(long offsetY = -radius; offsetY <= radius; offsetY++)
+            sum += mTurmites.getCell(x, wrap(static_cast<long>(y) + offsetY, mTurmites.getHeight()));
+        return sum;
+    }
+
+    //Adds the points from begin to end (inclusive, can be off either side of the board) as up to two ranges that don't wrap
+    static void getWrappedRanges(const long begin, const long end, const size_t size, std::vector<std::pair<size_t, size_t>> &ranges)
+    {
+        ranges.clear();
+        if(end - begin + 1 >= static_cast<long>(size))
+        {
+            ranges.emplace_back(0, size);
+            return;
+        }
+
+        const size_t wrappedBegin = wrap(begin, size), wrappedEnd = wrap(end, size);
+        if(wrappedBegin <= wrappedEnd)
+            ranges.emplace_back(wrappedBegin, wrappedEnd - wrappedBegin + 1);
+        else
+        {
+            ranges.emplace_back(wrappedBegin, size - wrappedBegin);
+            ranges.emplace_back(0, wrappedEnd + 1);
+        }
+    }
+
+public:
+    //One ant starts in the middle facing up like the classic ant, more than one are scattered randomly.
+    TurmiteGenerator(size_t resolutionX, size_t resolutionY, size_t seed, size_t antCount = 1, std::string_view rule = "RL", size_t blurRadius = 0) :
+        mTurmites(resolutionX, resolutionY, rule), mBlurRadius(blurRadius)
+    {
+        const double blurArea = static_cast<double>(((2 * blurRadius) + 1) * ((2 * blurRadius) + 1));
+        mColourScale = 1.0 / (static_cast<double>(mTurmites.getColourCount() - 1) * blurArea);
+
+        if(antCount == 1)
+            mTurmites.addAnt(resolutionX / 2, resolutionY / 2);
+        else
+        {
+            std::default_random_engine generator(seed);
+            std::uniform_int_distribution<size_t> xDist(0, resolutionX - 1), yDist(0, resolutionY - 1);
+            std::uniform_int_distribution<int> directionDist(0, 3);
+            for(size_t i = 0; i < antCount; i++)
+            {
+                const size_t x = xDist(generator), y = yDist(generator);
+                mTurmites.addAnt(x, y, static_cast<uint8_t>(directionDist(generator)));
+            }
+        }
+    }
+
+    double getPoint(size_t x, size_t y) override
+    {
+        if(mBlurRadius == 0)
+            return mTurmites.getCell(x, y) * mColourScale;
+
+        const long radius = static_cast<long>(mBlurRadius);
+        double sum = 0.0;
+        for(long offsetX = -radius; offsetX <= radius; offsetX++)
+            sum += getColumnSum(wrap(static_cast<long>(x) + offsetX, mTurmites.getWidth()), y);
+        return sum * mColourScale;
+    }
+
+    void getRow(size_t x, size_t y, std::span<double> points) override
+    {
+        if(mBlurRadius == 0)
+        {
+            for(size_t i = 0; i < points.size(); i++)
+                points[i] = mTurmites.getCell(x + i, y) * mColourScale;
+            return;
+        }
+
+        //Box blur, sum the columns once then slide a window across them. Rows are generated on several threads at once, hence thread_local.
+        thread_local std::vector<double> columnSums;
+        const size_t windowSize = (2 * mBlurRadius) + 1;
+        columnSums.resize(points.size() + windowSize - 1);
+        for(size_t i = 0; i < columnSums.size(); i++)
+            columnSums[i] = getColumnSum(wrap(static_cast<long>(x + i) - static_cast<long>(mBlurRadius), mTurmites.getWidth()), y);
+
+        double sum = 0.0;
+        for(size_t i = 0; i < windowSize - 1; i++)
+            sum += columnSums[i];
+        for(size_t i = 0; i < points.size(); i++)
+        {
+            sum += columnSums[i + windowSize - 1];
+            points[i] = sum * mColourScale;
+            sum -= columnSums[i];
+        }
+    }
+
+    //Runs of changed cells along each row, grown by the blur radius.
+    bool getDirtyRects(std::vector<SquaresRect> &dirtyRects) override
+    {
+        mChangedCells.clear();
+        mTurmites.takeChangedCells(mChangedCells);
+
+        const long radius = static_cast<long>(mBlurRadius);
+        const size_t width = mTurmites.getWidth(), height = mTurmites.getHeight();
+        std::vector<std::pair<size_t, size_t>> rangesX, rangesY;
+        for(size_t i = 0; i < mChangedCells.size(); )
+        {
+            const size_t first = mChangedCells[i], y = first / width;
+            size_t last = first;
+            for(i++; i < mChangedCells.size() && mChangedCells[i] == last + 1 && mChangedCells[i] / width == y; i++)
+                last = mChangedCells[i];
+
+            getWrappedRanges(static_cast<long>(first % width) - radius, static_cast<long>(last % width) + radius, width, rangesX);
+            getWrappedRanges(static_cast<long>(y) - radius, static_cast<long>(y) + radius, height, rangesY);
+            for(const auto &[rectY, rectHeight] : rangesY)
+                for(const auto &[rectX, rectWidth] : rangesX)
+                    dirtyRects.push_back({rectX, rectY, rectWidth, rectHeight});
+        }
+        return true;
+    }
+
+    //Add ants, set a thread pool, look at the board
+    Turmites &getTurmites()
+    {
+        return mTurmites;
+    }
+
+    void step(double delta)
+    {
+        mPendingSteps += delta * StepsPerSecond;
+        const double steps = std::floor(mPendingSteps);
+        mPendingSteps -= steps;
+        mTurmites.update(static_cast<uint64_t>(steps));
+    }
+};
+
+//this just helped me with implementing the interpolation algorithms.
+class TestPattern : public ISquaresGenerator
+{
+    constexpr static size_t TestPatternWidth = 5;
+    constexpr static size_t TestPatternHeight = 5;
+    constexpr static const std::array<double, 25> mTestPattern{ 0.0, 0.1, 0.1, 0.3, 0.2,
+                                                                0.1, 0.3, 0.6, 0.6, 0.3,
+                                                                0.3, 0.7, 0.9, 0.7, 0.3,
+                                                                0.2, 0.7, 0.8, 0.6, 0.2,
+                                                                0.1, 0.2, 0.3, 0.4, 0.7};
+public:
+    double getPoint(size_t x, size_t y) override
+    {
+        return mTestPattern[(y * TestPatternWidth) + x];
+    }
+
+    void getRow(size_t x, size_t y, std::span<double> points) override
+    {
+        std::copy_n(mTestPattern.begin() + static_cast<std::ptrdiff_t>((y * TestPatternWidth) + x), points.size(), points.begin());
+    }
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Per-stage timers and counters.
+//Every thread gets its own block of counters the first time it records something. Only the owning thread ever writes to a block, so
+//recording is a relaxed load and store with no locked instructions. snapshot() can read the blocks from any thread at any time.
+//
+//Build with MARCHING_SQUARES_INSTRUMENTATION=0 (the CMake option of the same name) and the MS_* macros expand to nothing,
+//so none of the timing code is compiled in. The snapshot API is still there, it just always reports zeros.
+#ifndef MARCHING_SQUARES_INSTRUMENTATION
+#define MARCHING_SQUARES_INSTRUMENTATION 0
+#endif
+
+namespace Instrumentation
+{
+    constexpr bool Enabled = MARCHING_SQUARES_INSTRUMENTATION != 0;
+
+    enum class Stage : size_t
+    {
+        Generate,       //Generator filling in the points, recalculate()
+        Classify,       //Comparing points against the iso level and building square types
+        Interpolate,    //Working out the vertex positions of non-empty squares
+        Emit,           //Handing vertices to the output
+        HandoffWait,    //Renderer waiting for a frame to be finished
+        WorkerIdle,     //Thread pool worker asleep with nothing to do
+        Draw,           //window.draw()
+        Count
+    };
+
+    enum class Counter : size_t
+    {
+        CellsVisited,   //Squares classified by render(), once per iso level
+        NonEmptyCells,  //Of those, the ones that emitted vertices
+        Count
+    };
+
+    constexpr size_t StageCount = static_cast<size_t>(Stage::Count);
+    constexpr size_t CounterCount = static_cast<size_t>(Counter::Count);
+    constexpr size_t MaxIsoLevels = 16; //Vertices are only counted for the first MaxIsoLevels iso levels
+
+    constexpr std::array<const char *, StageCount> StageNames{"generate", "classify", "interpolate", "emit", "handoff wait", "worker idle", "draw"};
+    constexpr std::array<const char *, CounterCount> CounterNames{"cells visited", "non-empty cells"};
+
+    //Plain copy of one thread's counters.
+    struct ThreadSnapshot
+    {
+        std::string name;
+        std::array<uint64_t, StageCount> stageNanoseconds{};
+        std::array<uint64_t, StageCount> stageCalls{};
+        std::array<uint64_t, CounterCount> counters{};
+        std::array<uint64_t, MaxIsoLevels> levelVertices{};
+
+        ThreadSnapshot &operator+=(const ThreadSnapshot &other)
+        {
+            for(size_t i = 0; i < StageCount; i++)
+            {
+                stageNanoseconds[i] += other.stageNanoseconds[i];
+                stageCalls[i] += other.stageCalls[i];
+            }
+            for(size_t i = 0; i < CounterCount; i++)
+                counters[i] += other.counters[i];
+            for(size_t i = 0; i < MaxIsoLevels; i++)
+                levelVertices[i] += other.levelVertices[i];
+            return *this;
+        }
+
+        ThreadSnapshot &operator-=(const ThreadSnapshot &other) //Counters only go up, so later - earlier is what happened in between.
+        {
+            for(size_t i = 0; i < StageCount; i++)
+            {
+                stageNanoseconds[i] -= other.stageNanoseconds[i];
+                stageCalls[i] -= other.stageCalls[i];
+            }
+            for(size_t i = 0; i < CounterCount; i++)
+                counters[i] -= other.counters[i];
+            for(size_t i = 0; i < MaxIsoLevels; i++)
+                levelVertices[i] -= other.levelVertices[i];
+            return *this;
+        }
+
+        double getStageMilliseconds(const Stage stage) const
+        {
+            return static_cast<double>(stageNanoseconds[static_cast<size_t>(stage)]) / 1e6;
+        }
+
+        uint64_t getCounter(const Counter counter) const
+        {
+            return counters[static_cast<size_t>(counter)];
+        }
+    };
+
+    //Every thread that has recorded something, in the order they first did. Threads that have exited are kept.
+    struct Snapshot
+    {
+        std::vector<ThreadSnapshot> threads;
+
+        ThreadSnapshot getTotal() const
+        {
+            ThreadSnapshot total;
+            total.name = "total";
+            for(const auto &thread : threads)
+                total += thread;
+            return total;
+        }
+    };
+
+    //One thread's counters. Single writer, so add() doesn't need fetch_add.
+    class ThreadCounters
+    {
+        std::string mName;
+        mutable std::mutex mNameSync; //Only the name needs a lock, it's set once and read by snapshot()
+        std::array<std::atomic<uint64_t>, StageCount> mStageNanoseconds{};
+        std::array<std::atomic<uint64_t>, StageCount> mStageCalls{};
+        std::array<std::atomic<uint64_t>, CounterCount> mCounters{};
+        std::array<std::atomic<uint64_t>, MaxIsoLevels> mLevelVertices{};
+
+        static void add(std::atomic<uint64_t> &value, const uint64_t amount)
+        {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+    public:
+        explicit ThreadCounters(std::string name) : mName(std::move(name)) {}
+
+        void setName(std::string name)
+        {
+            std::lock_guard lock(mNameSync);
+            mName = std::move(name);
+        }
+
+        void addStage(const Stage stage, const uint64_t nanoseconds)
+        {
+            add(mStageNanoseconds[static_cast<size_t>(stage)], nanoseconds);
+            add(mStageCalls[static_cast<size_t>(stage)], 1);
+        }
+
+        void addCounter(const Counter counter, const uint64_t amount)
+        {
+            add(mCounters[static_cast<size_t>(counter)], amount);
+        }
+
+        void addLevelVertices(const size_t isoLevelIndex, const uint64_t amount)
+        {
+            if(isoLevelIndex < MaxIsoLevels)
+                add(mLevelVertices[isoLevelIndex], amount);
+        }
+
+        ThreadSnapshot getSnapshot() const
+        {
+            ThreadSnapshot snapshot;
+            {
+                std::lock_guard lock(mNameSync);
+                snapshot.name = mName;
+            }
+            for(size_t i = 0; i < StageCount; i++)
+            {
+                snapshot.stageNanoseconds[i] = mStageNanoseconds[i].load(std::memory_order_relaxed);
+                snapshot.stageCalls[i] = mStageCalls[i].load(std::memory_order_relaxed);
+            }
+            for(size_t i = 0; i < CounterCount; i++)
+                snapshot.counters[i] = mCounters[i].load(std::memory_order_relaxed);
+            for(size_t i = 0; i < MaxIsoLevels; i++)
+                snapshot.levelVertices[i] = mLevelVertices[i].load(std::memory_order_relaxed);
+            return snapshot;
+        }
+    };
+
+    //Owns every thread's counters. The lock is only taken when a thread records for the first time and by snapshot().
+    class Registry
+    {
+        std::mutex mSync;
+        std::vector<std::unique_ptr<ThreadCounters>> mThreads;
+
+    public:
+        ThreadCounters &addThread()
+        {
+            std::lock_guard lock(mSync);
+            return *mThreads.emplace_back(std::make_unique<ThreadCounters>("thread " + std::to_string(mThreads.size())));
+        }
+
+        Snapshot getSnapshot()
+        {
+            std::lock_guard lock(mSync);
+            Snapshot snapshot;
+            for(const auto &thread : mThreads)
+                snapshot.threads.push_back(thread->getSnapshot());
+            return snapshot;
+        }
+
+        static Registry &instance()
+        {
+            static Registry registry;
+            return registry;
+        }
+    };
+
+    inline ThreadCounters &getThreadCounters()
+    {
+        thread_local ThreadCounters &counters = Registry::instance().addThread();
+        return counters;
+    }
+
+    inline Snapshot snapshot()
+    {
+        return Registry::instance().getSnapshot();
+    }
+
+    //Shows up in snapshots instead of "thread n".
+    inline void setThreadName(std::string name)
+    {
+        if constexpr(Enabled)
+            getThreadCounters().setName(std::move(name));
+    }
+
+    //Adds the time between construction and destruction to a stage.
+    class ScopedTimer
+    {
+        Stage mStage;
+        std::chrono::steady_clock::time_point mStartTime;
+
+    public:
+        explicit ScopedTimer(const Stage stage) : mStage(stage), mStartTime(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer()
+        {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStartTime);
+            getThreadCounters().addStage(mStage, static_cast<uint64_t>(elapsed.count()));
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+    };
+}
+
+#define MS_INSTRUMENTATION_CONCAT_INNER(a, b) a##b
+#define MS_INSTRUMENTATION_CONCAT(a, b) MS_INSTRUMENTATION_CONCAT_INNER(a, b)
+
+#if MARCHING_SQUARES_INSTRUMENTATION
+//Time the rest of the enclosing scope, e.g. MS_SCOPED_TIMER(Generate);
+#define MS_SCOPED_TIMER(stage) const Instrumentation::ScopedTimer MS_INSTRUMENTATION_CONCAT(msScopedTimer, __LINE__)(Instrumentation::Stage::stage)
+#define MS_COUNT(counter, amount) Instrumentation::getThreadCounters().addCounter(Instrumentation::Counter::counter, (amount))
+#define MS_COUNT_LEVEL_VERTICES(isoLevelIndex, amount) Instrumentation::getThreadCounters().addLevelVertices((isoLevelIndex), (amount))
+#else
+#define MS_SCOPED_TIMER(stage) ((void)0)
+#define MS_COUNT(counter, amount) ((void)sizeof(amount)) //sizeof doesn't evaluate amount, but it still counts as used
+#define MS_COUNT_LEVEL_VERTICES(isoLevelIndex, amount) ((void)sizeof(isoLevelIndex), (void)sizeof(amount))
+#endif
@@ -1,25 +1,230 @@
-#include <vector>
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <tuple>
+#include <vector>
+#include "ThreadPool.hpp"
 
+//Cells are stored as one bit each (1 is black) so big boards stay small and the ant's neighbourhood stays in cache.
+//
+//From an empty board the ant wanders chaotically for ~10000 steps and then builds a "highway", the same 104 steps over and over,
+//each time moving 2 cells diagonally. update(n) looks for that every so often and once it finds it, repeats the period by applying
+//its flips directly instead of stepping the ant through it. Every period is checked against the board before it's skipped,
+//so running into the ant's own trail (e.g. after wrapping around the board) drops back to normal stepping.
 template <size_t Width, size_t Height, class CellType = double>
 class LangstonsAnt
 {
     constexpr static size_t ArraySize = Width * Height;
-    std::vector<CellType> mCells;
+    constexpr static size_t WordBits = 64;
+    constexpr static size_t HighwayPeriod = 104;                //Steps before a highway repeats
+    constexpr static size_t HighwayCheckInterval = 1 << 14;     //Steps between looking for a highway
+
+    //How x and y change moving in each direction, up right down left. Adding Width-1 wraps around to x-1.
+    constexpr static std::array<size_t, 4> StepX{0, 1, 0, Width - 1};
+    constexpr static std::array<size_t, 4> StepY{Height - 1, 0, 1, 0};
+
+    std::vector<uint64_t> mBits;
+    std::vector<CellType> mCells; //Unpacked copy for getCells()
     std::tuple<size_t, size_t, uint8_t> mAnt;
+    uint64_t mStepCount = 0;
+    uint64_t mSkippedSteps = 0;
+    uint64_t mNextHighwayCheck = HighwayCheckInterval;
+
+    //A highway period found on the board, relative to where the ant starts it.
+    struct CellOffset
+    {
+        long x, y;
+        long index; //y * Width + x, for when the period doesn't wrap around the board
+        bool state;
+    };
+    struct Highway
+    {
+        long moveX = 0, moveY = 0;
+        long minX = 0, maxX = 0, minY = 0, maxY = 0; //Box around the cells the period reads
+        std::vector<CellOffset> flips;       //Cells flipped by one period
+        std::vector<CellOffset> leadingEdge; //Cells the next period reads that this one didn't, and what they have to be
+    };
 
-    inline const size_t pointToArray(const std::tuple<size_t, size_t> &point)
+    inline size_t pointToArray(const std::tuple<size_t, size_t> &point)
     {
         return (std::get<1>(point) * Width) + std::get<0>(point);
     }
 
     inline void flipCellState(const std::tuple<size_t, size_t> &point)
     {
-        mCells[pointToArray(point)] = mCells[pointToArray(point)] ? 0 : 1;
+        const size_t index = pointToArray(point);
+        mBits[index / WordBits] ^= uint64_t(1) << (index % WordBits);
+    }
+
+    bool getBit(const size_t x, const size_t y) const
+    {
+        const size_t index = (y * Width) + x;
+        return (mBits[index / WordBits] >> (index % WordBits)) & 1;
+    }
+
+    //x + offset around the board
+    template<size_t Size>
+    static size_t wrap(const size_t position, const long offset)
+    {
+        const long wrapped = (static_cast<long>(position) + offset) % static_cast<long>(Size);
+        return static_cast<size_t>(wrapped < 0 ? wrapped + static_cast<long>(Size) : wrapped);
+    }
+
+    //Shortest way from one position to another around the board
+    template<size_t Size>
+    static long getWrappedDistance(const size_t from, const size_t to)
+    {
+        const long distance = static_cast<long>(wrap<Size>(to, static_cast<long>(Size / 2) - static_cast<long>(from)));
+        return distance - static_cast<long>(Size / 2);
+    }
+
+    static bool isBoxInside(const Highway &highway, const size_t x, const size_t y)
+    {
+        return static_cast<long>(x) + highway.minX >= 0 && static_cast<long>(x) + highway.maxX < static_cast<long>(Width) &&
+               static_cast<long>(y) + highway.minY >= 0 && static_cast<long>(y) + highway.maxY < static_cast<long>(Height);
+    }
+
+    //Index of a cell of the period started at x/y. Wrapping is slow, so only done when the box crosses the edge of the board.
+    static size_t getCellIndex(const CellOffset &cell, const size_t x, const size_t y, const bool inside)
+    {
+        if(inside)
+            return static_cast<size_t>(static_cast<long>((y * Width) + x) + cell.index);
+        return (wrap<Height>(y, cell.y) * Width) + wrap<Width>(x, cell.x);
+    }
+
+    //The actual ant. Everything lives in locals so the loop is just loads, an xor and a few adds.
+    //If path isn't null the position before every step is written to it, relative to the starting position.
+    void runSteps(uint64_t steps, std::vector<std::pair<long, long>> *path = nullptr)
+    {
+        auto [x, y, r] = mAnt;
+        uint64_t *bits = mBits.data();
+        long pathX = 0, pathY = 0;
+        mStepCount += steps;
+
+        for(; steps > 0; steps--)
+        {
+            if(path)
+                path->emplace_back(pathX, pathY);
+
+            const size_t index = (y * Width) + x;
+            const uint64_t word = bits[index / WordBits];
+            bits[index / WordBits] = word ^ (uint64_t(1) << (index % WordBits));
+            const auto wasBlack = static_cast<uint8_t>((word >> (index % WordBits)) & 1);
+            r = (r + 1 + (2 * wasBlack)) & 3; //White turns clockwise (+1), black counter-clockwise (+3). No branch to mispredict.
+
+            x += StepX[r];
+            x = x >= Width ? x - Width : x;
+            y += StepY[r];
+            y = y >= Height ? y - Height : y;
+
+            if(path)
+            {
+                pathX += r == 1 ? 1 : (r == 3 ? -1 : 0);
+                pathY += r == 2 ? 1 : (r == 0 ? -1 : 0);
+            }
+        }
+        mAnt = std::make_tuple(x, y, r);
+    }
+
+    //Step one period while recording it, then check the next one is guaranteed to do exactly the same.
+    //It is if the cells it'll read are in the same state the recorded one found them in.
+    bool findHighway(Highway &highway)
+    {
+        const auto [startX, startY, startR] = mAnt;
+        std::vector<std::pair<long, long>> path;
+        path.reserve(HighwayPeriod);
+        runSteps(HighwayPeriod, &path);
+
+        const auto [endX, endY, endR] = mAnt;
+        long minX = 0, maxX = 0, minY = 0, maxY = 0;
+        for(const auto &[pathX, pathY] : path)
+        {
+            minX = std::min(minX, pathX); maxX = std::max(maxX, pathX);
+            minY = std::min(minY, pathY); maxY = std::max(maxY, pathY);
+        }
+        const long boxWidth = maxX - minX + 1, boxHeight = maxY - minY + 1;
+        highway.minX = minX; highway.maxX = maxX;
+        highway.minY = minY; highway.maxY = maxY;
+
+        highway.moveX = getWrappedDistance<Width>(startX, endX);
+        highway.moveY = getWrappedDistance<Height>(startY, endY);
+        if(endR != startR || (highway.moveX == 0 && highway.moveY == 0) || boxWidth + std::abs(highway.moveX) >= static_cast<long>(Width) ||
+           boxHeight + std::abs(highway.moveY) >= static_cast<long>(Height))
+            return false;
+
+        //Which cells in the box the period flipped an odd number of times
+        std::vector<uint8_t> flipped(static_cast<size_t>(boxWidth * boxHeight), 0);
+        for(const auto &[pathX, pathY] : path)
+            flipped[((pathY - minY) * boxWidth) + (pathX - minX)] ^= 1;
+
+        //The box as the period found it, and whether the box the next period reads is the same
+        const auto wasBlack = [&](const long offsetX, const long offsetY)
+        {
+            return getBit(wrap<Width>(startX, offsetX), wrap<Height>(startY, offsetY)) != (flipped[((offsetY - minY) * boxWidth) + (offsetX - minX)] != 0);
+        };
+        highway.flips.clear();
+        highway.leadingEdge.clear();
+        for(long offsetY = minY; offsetY <= maxY; offsetY++)
+        {
+            for(long offsetX = minX; offsetX <= maxX; offsetX++)
+            {
+                const bool state = wasBlack(offsetX, offsetY);
+                if(getBit(wrap<Width>(endX, offsetX), wrap<Height>(endY, offsetY)) != state)
+                    return false;
+
+                if(flipped[((offsetY - minY) * boxWidth) + (offsetX - minX)])
+                    highway.flips.push_back({offsetX, offsetY, (offsetY * static_cast<long>(Width)) + offsetX, true});
+
+                //Cells the period after won't have seen from here
+                const long previousX = offsetX + highway.moveX, previousY = offsetY + highway.moveY;
+                if(previousX < minX || previousX > maxX || previousY < minY || previousY > maxY)
+                    highway.leadingEdge.push_back({offsetX, offsetY, (offsetY * static_cast<long>(Width)) + offsetX, state});
+            }
+        }
+        return true;
+    }
+
+    //Repeat whole periods for as long as the board ahead matches. Returns the number of steps skipped.
+    uint64_t followHighway(const Highway &highway, uint64_t steps)
+    {
+        auto &[x, y, r] = mAnt;
+        uint64_t skipped = 0;
+        while(steps - skipped >= HighwayPeriod)
+        {
+            //The ant is at the start of a period that's known to repeat, apply it
+            const bool flipsInside = isBoxInside(highway, x, y);
+            for(const auto &flip : highway.flips)
+            {
+                const size_t index = getCellIndex(flip, x, y, flipsInside);
+                mBits[index / WordBits] ^= uint64_t(1) << (index % WordBits);
+            }
+            x = wrap<Width>(x, highway.moveX);
+            y = wrap<Height>(y, highway.moveY);
+            skipped += HighwayPeriod;
+
+            //The one after only repeats if the cells new to it are what the recorded period saw
+            const bool edgeInside = isBoxInside(highway, x, y);
+            const bool repeats = std::all_of(highway.leadingEdge.begin(), highway.leadingEdge.end(), [&](const CellOffset &cell)
+            {
+                const size_t index = getCellIndex(cell, x, y, edgeInside);
+                return ((mBits[index / WordBits] >> (index % WordBits)) & 1) == cell.state;
+            });
+            if(!repeats)
+                break;
+        }
+        mStepCount += skipped;
+        mSkippedSteps += skipped;
+        return skipped;
     }
 
 public:
-    LangstonsAnt() : mCells(ArraySize, 0), mAnt(std::make_tuple(Width/2, Height/2, 0)) {}
+    LangstonsAnt() : mBits((ArraySize + WordBits - 1) / WordBits, 0), mAnt(std::make_tuple(Width/2, Height/2, 0)) {}
 
     /***************************************
     At a white square, turn 90 clockwise, flip the color of the square, move forward one unit
@@ -27,51 +232,336 @@ public:
     ****************************************/
     void update()
     {
-        auto &[x, y, r] = mAnt;
-        flipCellState(std::make_tuple(x, y));
-        CellType state = getCellState(std::make_tuple(x, y));
+        runSteps(1);
+    }
 
-        if(state > 0)
+    //Advance steps steps, skipping through highways when the ant is on one.
+    void update(uint64_t steps)
+    {
+        Highway highway;
+        while(steps > 0)
         {
-            ++r;
-            r = r > 3 ? 0 : r;
+            if(mStepCount < mNextHighwayCheck || steps < HighwayPeriod * 2)
+            {
+                const uint64_t runLength = std::min(steps, mNextHighwayCheck > mStepCount ? mNextHighwayCheck - mStepCount : steps);
+                runSteps(runLength);
+                steps -= runLength;
+                continue;
+            }
+
+            mNextHighwayCheck = mStepCount + HighwayCheckInterval;
+            steps -= HighwayPeriod; //findHighway() always runs one period
+            if(findHighway(highway))
+            {
+                const uint64_t skipped = followHighway(highway, steps);
+                steps -= skipped;
+                if(skipped > 0)
+                    mNextHighwayCheck = mStepCount; //Probably still on it if it stopped because steps ran out
+            }
         }
-        else
+    }
+
+    //Unpacks the board, so not something to call every step.
+    const std::vector<CellType> &getCells()
+    {
+        mCells.resize(ArraySize);
+        for(size_t i = 0; i < ArraySize; i++)
+            mCells[i] = static_cast<CellType>((mBits[i / WordBits] >> (i % WordBits)) & 1);
+        return mCells;
+    }
+
+    //One bit per cell, bit i % 64 of word i / 64 is cell i.
+    const std::vector<uint64_t> &getBits() const
+    {
+        return mBits;
+    }
+
+    inline const CellType getCellState(const std::tuple<size_t, size_t> &point)
+    {
+        return static_cast<CellType>(getBit(std::get<0>(point), std::get<1>(point)));
+    }
+
+    //x, y, direction (0 up, 1 right, 2 down, 3 left)
+    const std::tuple<size_t, size_t, uint8_t> &getAnt() const
+    {
+        return mAnt;
+    }
+
+    uint64_t getStepCount() const
+    {
+        return mStepCount;
+    }
+
+    //How many of getStepCount() were skipped on highways
+    uint64_t getSkippedSteps() const
+    {
+        return mSkippedSteps;
+    }
+};
+
+//Any number of ants on a board of any size, following a turmite rule. Cells have one colour per letter of the rule and an ant on a cell
+//turns the way that colour's letter says (L left, R right, N no turn, U u-turn), moves the cell on to the next colour and steps forward.
+//"RL" is the classic Langton's ant, "LLRR", "RLR", "LRRRRRLLR" and so on make other patterns.
+//
+//Every step all the ants move once, in the order they were added. Ants on the same cell at the same step see the colour each other
+//leave behind in that order, so the result is always the same no matter how many threads run it.
+//Ants more than 2 * n cells apart can't meet within n steps, so update() splits the board into regions of ants that are close enough to
+//meet and runs each region for a batch of steps on its own, in parallel when there's a thread pool.
+class Turmites
+{
+public:
+    struct Ant
+    {
+        size_t x, y;
+        uint8_t direction; //0 up, 1 right, 2 down, 3 left
+    };
+
+private:
+    constexpr static size_t MinBatchSteps = 4;
+    constexpr static size_t MaxBatchSteps = 1024;
+
+    //Ants that might meet during a batch, and the cells they visited for the first time since changes were last taken.
+    struct Region
+    {
+        std::vector<uint32_t> ants;
+        std::vector<size_t> touchedCells;
+    };
+
+    size_t mWidth, mHeight;
+    std::vector<uint8_t> mTurns;        //Direction change for each colour, added to the ant's direction
+    std::vector<uint8_t> mCells;        //Colour of every cell
+    std::vector<Ant> mAnts;
+    ThreadPool *mThreadPool = nullptr;
+    size_t mBatchSteps = 64;            //Grows while ants are spread out and shrinks when they bunch up
+
+    std::vector<uint8_t> mReportedCells;//Colours as of the last takeChangedCells()
+    std::vector<uint8_t> mTouched;      //Visited since then, so every cell is only listed once
+    std::vector<size_t> mTouchedCells;
+
+    std::vector<uint32_t> mParents;     //Union find for building the regions
+    std::vector<uint32_t> mBucketStart; //Ants sorted into a coarse grid, so only ants in neighbouring buckets are compared
+    std::vector<uint32_t> mBucketAnts;
+    std::vector<Region> mRegions;
+
+    static uint8_t getTurn(const char rule)
+    {
+        switch(rule)
+        {
+        case 'N': return 0;
+        case 'R': return 1;
+        case 'U': return 2;
+        case 'L': return 3;
+        }
+        throw std::runtime_error(std::string("Unknown turmite rule '") + rule + "', expected L, R, N or U");
+    }
+
+    inline void stepAnt(Ant &ant, std::vector<size_t> &touchedCells)
+    {
+        const size_t index = (ant.y * mWidth) + ant.x;
+        uint8_t &cell = mCells[index];
+        ant.direction = (ant.direction + mTurns[cell]) & 3;
+        cell = (static_cast<size_t>(cell) + 1 == mTurns.size()) ? 0 : cell + 1;
+        if(!mTouched[index])
         {
-            --r;
-            r = r > 3 ? 3 : r;
+            mTouched[index] = 1;
+            touchedCells.push_back(index);
         }
 
-        switch(r)
-        {
-        case 0:
-            --y;
-            if(y > Height) y = Height-1;
-            break;
-        case 1:
-            ++x;
-            if(x > Width) x = 0;
-            break;
-        case 2:
-            ++y;
-            if(y > Height) y = 0;
-            break;
-        case 3:
-            --x;
-            if(x > Width) x = Width-1;
-            break;
+        switch(ant.direction)
+        {
+        case 0: ant.y = (ant.y == 0 ? mHeight : ant.y) - 1; break;
+        case 1: ant.x = (ant.x + 1 == mWidth) ? 0 : ant.x + 1; break;
+        case 2: ant.y = (ant.y + 1 == mHeight) ? 0 : ant.y + 1; break;
+        case 3: ant.x = (ant.x == 0 ? mWidth : ant.x) - 1; break;
         }
     }
 
-    const std::vector<CellType> &getCells()
+    //Step by step, ant by ant. Only touches cells within steps of the region's ants, which no other region can reach.
+    void runRegion(Region &region, const size_t steps)
+    {
+        if(region.ants.size() == 1) //Nothing to take turns with
+        {
+            Ant &ant = mAnts[region.ants.front()];
+            for(size_t step = 0; step < steps; step++)
+                stepAnt(ant, region.touchedCells);
+            return;
+        }
+
+        for(size_t step = 0; step < steps; step++)
+            for(const auto antIndex : region.ants)
+                stepAnt(mAnts[antIndex], region.touchedCells);
+    }
+
+    uint32_t findRoot(uint32_t antIndex)
+    {
+        while(mParents[antIndex] != antIndex)
+        {
+            mParents[antIndex] = mParents[mParents[antIndex]];
+            antIndex = mParents[antIndex];
+        }
+        return antIndex;
+    }
+
+    size_t getWrappedDistance(const size_t from, const size_t to, const size_t size) const
+    {
+        const size_t distance = from > to ? from - to : to - from;
+        return std::min(distance, size - distance);
+    }
+
+    //Group ants that could touch the same cell within steps steps, i.e. are within 2 * steps of each other.
+    void buildRegions(const size_t steps)
+    {
+        const size_t reach = 2 * steps;
+
+        //Buckets at least reach + 1 wide (the last one takes the remainder), so ants in buckets that aren't neighbours are too far apart to meet
+        const size_t bucketCountX = std::max<size_t>(mWidth / (reach + 1), 1), bucketCountY = std::max<size_t>(mHeight / (reach + 1), 1);
+        const auto getBucket = [&](const Ant &ant)
+        {
+            return (std::min(ant.y / (reach + 1), bucketCountY - 1) * bucketCountX) + std::min(ant.x / (reach + 1), bucketCountX - 1);
+        };
+
+        mBucketStart.assign((bucketCountX * bucketCountY) + 1, 0);
+        for(const auto &ant : mAnts)
+            mBucketStart[getBucket(ant) + 1]++;
+        for(size_t i = 1; i < mBucketStart.size(); i++)
+            mBucketStart[i] += mBucketStart[i-1];
+        mBucketAnts.resize(mAnts.size());
+        std::vector<uint32_t> nextSlot(mBucketStart.begin(), mBucketStart.end() - 1);
+        for(uint32_t antIndex = 0; antIndex < mAnts.size(); antIndex++)
+            mBucketAnts[nextSlot[getBucket(mAnts[antIndex])]++] = antIndex;
+
+        mParents.resize(mAnts.size());
+        std::iota(mParents.begin(), mParents.end(), 0);
+        for(uint32_t antIndex = 0; antIndex < mAnts.size(); antIndex++)
+        {
+            const Ant &ant = mAnts[antIndex];
+            const size_t bucket = getBucket(ant), bucketX = bucket % bucketCountX, bucketY = bucket / bucketCountX;
+            for(size_t offsetY = 0; offsetY < 3; offsetY++)
+            {
+                for(size_t offsetX = 0; offsetX < 3; offsetX++)
+                {
+                    //The board wraps around, so do the buckets
+                    const size_t otherBucket = (((bucketY + bucketCountY + offsetY - 1) % bucketCountY) * bucketCountX) + ((bucketX + bucketCountX + offsetX - 1) % bucketCountX);
+                    for(uint32_t slot = mBucketStart[otherBucket]; slot < mBucketStart[otherBucket + 1]; slot++)
+                    {
+                        const uint32_t otherIndex = mBucketAnts[slot];
+                        const Ant &other = mAnts[otherIndex];
+                        if(otherIndex > antIndex && getWrappedDistance(ant.x, other.x, mWidth) <= reach && getWrappedDistance(ant.y, other.y, mHeight) <= reach)
+                            mParents[findRoot(otherIndex)] = findRoot(antIndex);
+                    }
+                }
+            }
+        }
+
+        //Regions are in order of their first ant, and their ants stay in the order they were added
+        for(auto &region : mRegions)
+            region.ants.clear();
+        size_t regionCount = 0;
+        std::vector<uint32_t> regionOfRoot(mAnts.size(), std::numeric_limits<uint32_t>::max());
+        for(uint32_t antIndex = 0; antIndex < mAnts.size(); antIndex++)
+        {
+            const uint32_t root = findRoot(antIndex);
+            if(regionOfRoot[root] == std::numeric_limits<uint32_t>::max())
+            {
+                regionOfRoot[root] = static_cast<uint32_t>(regionCount++);
+                if(mRegions.size() < regionCount)
+                    mRegions.emplace_back();
+            }
+            mRegions[regionOfRoot[root]].ants.push_back(antIndex);
+        }
+        mRegions.resize(regionCount);
+    }
+
+public:
+    Turmites(size_t width, size_t height, const std::string_view rule = "RL") : mWidth(width), mHeight(height), mCells(width * height, 0),
+                                                                                 mReportedCells(width * height, 0), mTouched(width * height, 0)
+    {
+        if(rule.size() < 2 || rule.size() > 255)
+            throw std::runtime_error("A turmite rule needs 2 to 255 colours");
+        for(const char turn : rule)
+            mTurns.push_back(getTurn(turn));
+    }
+
+    void addAnt(size_t x, size_t y, uint8_t direction = 0)
+    {
+        mAnts.push_back({x % mWidth, y % mHeight, static_cast<uint8_t>(direction & 3)});
+    }
+
+    //Regions are spread over the pool's threads
+    void setThreadPool(ThreadPool *threadPool)
+    {
+        mThreadPool = threadPool;
+    }
+
+    //Move every ant steps times.
+    void update(uint64_t steps)
+    {
+        while(steps > 0 && !mAnts.empty())
+        {
+            //A lone ant can't meet anything, so it just runs.
+            const size_t batchSteps = mAnts.size() == 1 ? steps : static_cast<size_t>(std::min<uint64_t>(steps, mBatchSteps));
+            buildRegions(batchSteps);
+
+            if(mThreadPool && mRegions.size() > 1)
+                mThreadPool->parallelFor(mRegions.size(), [this, batchSteps](const size_t regionIndex) { runRegion(mRegions[regionIndex], batchSteps); });
+            else
+                for(auto &region : mRegions)
+                    runRegion(region, batchSteps);
+
+            size_t largestRegion = 0;
+            for(auto &region : mRegions)
+            {
+                largestRegion = std::max(largestRegion, region.ants.size());
+                mTouchedCells.insert(mTouchedCells.end(), region.touchedCells.begin(), region.touchedCells.end());
+                region.touchedCells.clear();
+            }
+
+            //Shorter batches split the ants up into more regions when they're bunched together, longer ones cost less to set up.
+            if(largestRegion * 2 > mAnts.size() && mAnts.size() > 1)
+                mBatchSteps = std::max(mBatchSteps / 2, MinBatchSteps);
+            else if(largestRegion * 4 <= mAnts.size())
+                mBatchSteps = std::min(mBatchSteps * 2, MaxBatchSteps);
+            steps -= batchSteps;
+        }
+    }
+
+    //Appends the index (y * width + x) of every cell whose colour is different to the last time this was called, in order.
+    void takeChangedCells(std::vector<size_t> &changedCells)
+    {
+        std::sort(mTouchedCells.begin(), mTouchedCells.end());
+        for(const auto index : mTouchedCells)
+        {
+            mTouched[index] = 0;
+            if(mCells[index] != mReportedCells[index]) //Cells can be visited enough times to end up back where they started
+            {
+                mReportedCells[index] = mCells[index];
+                changedCells.push_back(index);
+            }
+        }
+        mTouchedCells.clear();
+    }
+
+    //Colour of every cell, 0 to getColourCount()-1
+    const std::vector<uint8_t> &getCells() const
     {
         return mCells;
     }
 
-    inline const CellType getCellState(const std::tuple<size_t, size_t> &point)
+    uint8_t getCell(const size_t x, const size_t y) const
     {
-        return mCells[pointToArray(point)];
+        return mCells[(y * mWidth) + x];
     }
 
+    size_t getColourCount() const
+    {
+        return mTurns.size();
+    }
+
+    const std::vector<Ant> &getAnts() const
+    {
+        return mAnts;
+    }
 
+    size_t getWidth() const { return mWidth; }
+    size_t getHeight() const { return mHeight; }
 };
@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Read-only memory mapping of a whole file. Pages are only loaded as they are touched, so files much larger than RAM can be read.
+class MappedFile
+{
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+#endif
+
+    void unmap()
+    {
+#ifdef _WIN32
+        if(mData) UnmapViewOfFile(mData);
+        if(mMapping) CloseHandle(mMapping);
+        if(mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+        mMapping = nullptr;
+#else
+        if(mData) munmap(const_cast<uint8_t *>(mData), mSize);
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+
+public:
+    explicit MappedFile(const std::string &path)
+    {
+#ifdef _WIN32
+        mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER fileSize{};
+        if(mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &fileSize))
+        {
+            unmap();
+            throw std::runtime_error("Unable to open " + path);
+        }
+        mSize = static_cast<size_t>(fileSize.QuadPart);
+        if(mSize == 0)
+            return;
+
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mData = mMapping ? static_cast<const uint8_t *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if(!mData)
+        {
+            unmap();
+            throw std::runtime_error("Unable to map " + path);
+        }
+#else
+        const int file = open(path.c_str(), O_RDONLY);
+        struct stat fileInfo{};
+        if(file < 0 || fstat(file, &fileInfo) != 0)
+        {
+            if(file >= 0) close(file);
+            throw std::runtime_error("Unable to open " + path);
+        }
+        mSize = static_cast<size_t>(fileInfo.st_size);
+        if(mSize == 0)
+        {
+            close(file);
+            return;
+        }
+
+        void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file); //The mapping keeps its own reference to the file
+        if(data == MAP_FAILED)
+        {
+            mSize = 0;
+            throw std::runtime_error("Unable to map " + path);
+        }
+        mData = static_cast<const uint8_t *>(data);
+        madvise(data, mSize, MADV_SEQUENTIAL);
+#endif
+    }
+
+    ~MappedFile()
+    {
+        unmap();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    //Tell the OS a range won't be read again so its pages can be dropped, this keeps a sequential pass from filling memory with old pages.
+    //Works in whole pages, so the page holding offset can be dropped with it. That only costs a reload if it's read again.
+    void release(size_t offset, size_t length) const
+    {
+#ifndef _WIN32
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        //madvise needs page aligned addresses. begin is rounded down, the end is rounded down so nothing after the range is dropped.
+        const size_t begin = (offset / pageSize) * pageSize;
+        const size_t end = std::min(offset + length, mSize);
+        if(mData && end >= begin + pageSize)
+            madvise(const_cast<uint8_t *>(mData) + begin, ((end - begin) / pageSize) * pageSize, MADV_DONTNEED);
+#else
+        (void)offset;
+        (void)length;
+#endif
+    }
+};
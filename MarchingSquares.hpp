@@ -1,10 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "Instrumentation.hpp"
+#include "SquareClassifier.hpp"
+#include "ThreadPool.hpp"
+
+//A rectangle of grid points, or of squares.
+struct SquaresRect
+{
+    size_t x, y, width, height;
+};
 
 //A couple of adapters to decouple grid generators and the output vertices.
 class ISquaresGenerator
 {
 public:
+    //When MarchingSquares has a thread pool, getRow()/getTile() are called from several threads at once for different rows.
     virtual double getPoint(size_t x, size_t y) = 0;
+
+    //Fill points with a row of points starting at x/y. Generators that can produce points in bulk should override this,
+    //the default just falls back to getPoint() so simple generators still work.
+    virtual void getRow(size_t x, size_t y, std::span<double> points)
+    {
+        for(size_t i = 0; i < points.size(); i++)
+            points[i] = getPoint(x + i, y);
+    }
+
+    //Fill a width*height tile of points starting at x/y. Rows are stride points apart in the points buffer.
+    virtual void getTile(size_t x, size_t y, size_t width, size_t height, std::span<double> points, size_t stride)
+    {
+        for(size_t row = 0; row < height; row++)
+            getRow(x, y + row, points.subspan(row * stride, width));
+    }
+
+    //Used by MarchingSquares::update(). Add the rectangles of points that changed since the last call to dirtyRects and return true,
+    //or return false if the generator doesn't keep track and every point has to be regenerated (the default).
+    virtual bool getDirtyRects(std::vector<SquaresRect> &)
+    {
+        return false;
+    }
+};
+
+//Vertex positions handed to an output in bulk.
+struct SquaresVertex
+{
+    float x, y;
 };
 
 class ISquaresOutput
@@ -14,18 +63,403 @@ public:
     virtual void addVertex(double isoLevel, double x, double y) = 0;
 
     [[maybe_unused]] virtual void setVertex(size_t vertexIndex, double x, double y) = 0;
+
+    //Called before the vertices of a frame are written, so per iso level lookups (colours etc.) only need to be worked out once.
+    virtual void setIsoLevels(const std::vector<double> &) {}
+
+    //Write a run of vertices belonging to isoLevels[isoLevelIndex] into slots firstVertex onwards.
+    //The buffer has already been sized by resetVertices(), the default just calls setVertex() for each vertex.
+    //With a thread pool, render() calls this from several threads at once, but never for overlapping slots.
+    virtual void writeVertices(size_t firstVertex, size_t, std::span<const SquaresVertex> vertices)
+    {
+        for(size_t i = 0; i < vertices.size(); i++)
+            setVertex(firstVertex + i, vertices[i].x, vertices[i].y);
+    }
 };
 
+//Output for MarchingSquares::renderIndexed(). Each iso level is a mesh of shared vertices and triangle indices,
+//so a crossing shared by two squares is only stored once.
+class ISquaresIndexedOutput
+{
+public:
+    virtual void resetMeshes(const std::vector<double> &isoLevels) = 0;
+    virtual void addMesh(size_t isoLevelIndex, std::span<const SquaresVertex> vertices, std::span<const uint32_t> indices) = 0;
+};
+
+//A run of vertices making up one contour line. Closed polylines loop back to their first vertex, which isn't repeated at the end.
+struct SquaresPolyline
+{
+    uint32_t firstVertex, vertexCount;
+    bool closed;
+};
 
-template <size_t ResolutionX, size_t ResolutionY, size_t PixelsPerPointX, size_t PixelsPerPointY>
+//Output for MarchingSquares::renderPolylines(). Each iso level is a set of connected lines, every crossing is stored once per line
+//instead of once per triangle using it, for line renderers and exporters that want paths rather than filled regions.
+class ISquaresPolylineOutput
+{
+public:
+    virtual void resetPolylines(const std::vector<double> &isoLevels) = 0;
+    //polylines index into vertices.
+    virtual void addPolylines(size_t isoLevelIndex, std::span<const SquaresVertex> vertices, std::span<const SquaresPolyline> polylines) = 0;
+};
+
+//Output for MarchingSquares::update(). The grid is split into chunks of squares and each chunk keeps its own vertices per iso level,
+//so when only part of the grid changes only the chunks it touches are replaced.
+class ISquaresChunkedOutput
+{
+public:
+    //The chunk layout or iso levels changed, every chunk will be written again. Chunks are numbered row by row.
+    virtual void resetChunks(size_t chunkCountX, size_t chunkCountY, const std::vector<double> &isoLevels) = 0;
+    //Replace the vertices of a chunk for isoLevels[isoLevelIndex]. With a thread pool this is called from several threads at once, for different chunks.
+    virtual void updateChunk(size_t chunkIndex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) = 0;
+};
+
+//Any of the size template arguments can be std::dynamic_extent (like std::span), that dimension is then given to the constructor and can be changed with
+//resize()/setPixelsPerPoint(). Fixed dimensions are compile time constants, MarchingSquares<> is a fully runtime sized grid.
+//PointType is how the grid is stored: double, float, or uint16_t/uint8_t quantized with setQuantization(). Narrower points mean less memory
+//traffic on big grids, generators still produce doubles and vertices are still floats.
+template <size_t ResolutionX = std::dynamic_extent, size_t ResolutionY = std::dynamic_extent, size_t PixelsPerPointX = std::dynamic_extent, size_t PixelsPerPointY = std::dynamic_extent,
+          typename PointType = double>
 class MarchingSquares
 {
-    constexpr static size_t ArraySize = ResolutionX * ResolutionY;
+    static_assert(std::is_same_v<PointType, double> || std::is_same_v<PointType, float> || std::is_same_v<PointType, uint16_t> || std::is_same_v<PointType, uint8_t>,
+                  "Points can be stored as double, float, uint16_t or uint8_t");
+
+    //Only used for dimensions that are std::dynamic_extent, see getResolutionX() etc.
+    size_t mResolutionX, mResolutionY, mPixelsPerPointX, mPixelsPerPointY;
+
+    std::vector<PointType> mAllPoints;
+
+    //Quantized points are stored as round((value - offset) / scale), the default maps [0, 1] onto the full integer range.
+    constexpr static double MaxQuantizedPoint = static_cast<double>(std::numeric_limits<PointType>::max());
+    double mQuantizationScale = std::is_integral_v<PointType> ? 1.0 / MaxQuantizedPoint : 1.0;
+    double mQuantizationOffset = 0.0;
+
+    //An iso level converted to the stored point type, so rows can be classified without converting every point back to double.
+    struct IsoThreshold
+    {
+        enum Kind : uint8_t
+        {
+            Compare,    //Above if point > value
+            AllAbove,   //The iso level is below anything that can be stored
+            NoneAbove   //or above it
+        };
+        PointType value;
+        Kind kind;
+    };
+    std::vector<IsoThreshold> mLevelThresholds; //renderSinglePass() scratch
+
+    //update() state. Chunks are only valid for the iso levels and grid layout they were last written with.
+    std::vector<double> mChunkIsoLevels;
+    bool mChunksValid = false;
+    std::vector<SquaresRect> mDirtyRects;
+    std::vector<uint8_t> mDirtyChunks;      //One flag per chunk
+    std::vector<size_t> mDirtyChunkList;
+
+    constexpr static size_t GeneratedRows = 8; //Rows converted at a time when points aren't doubles
+
+    //Min/max pyramid. Level 0 has the range of the points of every BlockSquares x BlockSquares block of squares (corners included), each level above
+    //covers 2x2 blocks of the one below, up to a single block. Blocks the iso level doesn't pass through are never classified, see getBlockSpans().
+    constexpr static size_t BlockSquares = 16;
+    struct BlockBounds
+    {
+        PointType min, max;
+    };
+    struct BlockLevel
+    {
+        size_t countX, countY;
+        std::vector<BlockBounds> bounds;
+    };
+    std::vector<BlockLevel> mBlockLevels;
+
+    enum class BlockStatus : uint8_t
+    {
+        Below,  //Every point is below the iso level, all squares are type 0
+        Above,  //Every point is above it, all squares are type 15
+        Mixed   //Has to be classified
+    };
+
+    //A run of squares along a row of blocks that are all on the same side of the iso level, or all need classifying.
+    struct BlockSpan
+    {
+        size_t beginX, endX;
+        BlockStatus status;
+    };
+
+    //Scratch space for marching a band of rows. With a thread pool the grid is split into several bands which are marched in parallel.
+    struct RowBand
+    {
+        std::array<std::vector<uint8_t>, 2> pointsAboveIso; //Two rolling rows of classified points, one byte per point.
+        std::vector<uint8_t> squareTypes;                    //Square types for the row currently being marched.
+        std::vector<SquaresVertex> rowVertices;              //Vertices of the current row, written to the output in one go.
+        std::vector<size_t> firstVertex;                     //Output slot of the band's first vertex for each iso level.
+        std::vector<double> generatedPoints;                 //Generator output waiting to be converted, only used when points aren't doubles.
+        std::vector<BlockSpan> blockSpans;                   //Spans of the row of blocks being marched, valid inside forEachSquareRow() callbacks.
+        std::vector<std::vector<SquaresVertex>> levelVertices; //renderIsolines() segments for each iso level.
+
+        void resize(const size_t resolutionX) //Only reallocates when the grid gets wider
+        {
+            if constexpr(!std::is_same_v<PointType, double>)
+                generatedPoints.resize(resolutionX * GeneratedRows);
+            pointsAboveIso[0].resize(resolutionX, 0);
+            pointsAboveIso[1].resize(resolutionX, 0);
+            squareTypes.resize(resolutionX, 0);
+            rowVertices.reserve((resolutionX-1) * squareIndicies[0].size()); //Enough for a row of the busiest square type
+        }
+    };
+    std::vector<RowBand> mBands;
+    ThreadPool *mThreadPool = nullptr;
+    std::vector<std::vector<SquaresVertex>> mLevelVertices; //Per iso level vertices for renderSinglePass(), reused between frames.
+
+    //renderIsolines() level lookup. Evenly spaced levels are found by dividing, anything else by binary search.
+    bool mIsolinesUniform = false;
+    double mIsolineFirst = 0.0, mIsolineStep = 0.0;
+
+    //renderIndexed() state. The caches hold the mesh index of each edge crossing/corner, or NoVertex if it hasn't been emitted yet.
+    constexpr static uint32_t NoVertex = std::numeric_limits<uint32_t>::max();
+    std::vector<SquaresVertex> mMeshVertices;
+    std::vector<uint32_t> mMeshIndices;
+    std::array<std::vector<uint32_t>, 2> mHorizontalEdgeCache; //Top and bottom edges of the current row of squares
+    std::array<std::vector<uint32_t>, 2> mCornerCache;         //Top and bottom corners of the current row of squares
+    std::vector<uint32_t> mVerticalEdgeCache;                  //Left/right edges, only shared within a row
+
+    //renderPolylines() state, shares the edge caches above. Every crossing links to the (up to) two crossings it shares a square with.
+    std::vector<std::array<uint32_t, 2>> mCrossingLinks;
+    std::vector<uint8_t> mCrossingVisited;
+    std::vector<SquaresVertex> mPolylineVertices;
+    std::vector<SquaresPolyline> mPolylines;
 
-    std::vector<double> mAllPoints;
+    size_t mGridOffsetX = 0, mGridOffsetY = 0; //Where point 0,0 sits in output coordinates, in points.
 
     ISquaresGenerator &mGenerator;
-    ISquaresOutput &mOutput;
+    ISquaresOutput *mOutput;                //Only one of these is set, depending on the constructor
+    ISquaresChunkedOutput *mChunkedOutput;
+
+    PointType toPointType(const double value) const
+    {
+        if constexpr(std::is_integral_v<PointType>)
+            return static_cast<PointType>(std::clamp(std::round((value - mQuantizationOffset) / mQuantizationScale), 0.0, MaxQuantizedPoint));
+        else
+            return static_cast<PointType>(value);
+    }
+
+    double toDouble(const PointType point) const
+    {
+        if constexpr(std::is_integral_v<PointType>)
+            return (static_cast<double>(point) * mQuantizationScale) + mQuantizationOffset;
+        else
+            return static_cast<double>(point);
+    }
+
+    //For whole numbers point * scale + offset > isoLevel is the same as point > floor((isoLevel - offset) / scale).
+    //Floats round the iso level down, so point > threshold matches comparing the point against the double iso level exactly.
+    IsoThreshold getIsoThreshold(const double isoLevel) const
+    {
+        if constexpr(std::is_integral_v<PointType>)
+        {
+            const double threshold = std::floor((isoLevel - mQuantizationOffset) / mQuantizationScale);
+            if(threshold < 0.0)
+                return {0, IsoThreshold::AllAbove};
+            if(threshold >= MaxQuantizedPoint)
+                return {0, IsoThreshold::NoneAbove};
+            return {static_cast<PointType>(threshold), IsoThreshold::Compare};
+        }
+        else if constexpr(std::is_same_v<PointType, float>)
+        {
+            float threshold = static_cast<float>(isoLevel);
+            if(static_cast<double>(threshold) > isoLevel)
+                threshold = std::nextafter(threshold, -std::numeric_limits<float>::infinity());
+            return {threshold, IsoThreshold::Compare};
+        }
+        else
+            return {isoLevel, IsoThreshold::Compare};
+    }
+
+    static bool isAboveIso(const PointType point, const IsoThreshold &threshold)
+    {
+        return (threshold.kind == IsoThreshold::Compare) ? point > threshold.value : threshold.kind == IsoThreshold::AllAbove;
+    }
+
+    //Classify count points of row y starting at x.
+    inline void classifyPoints(const size_t x, const size_t y, const size_t count, const IsoThreshold &threshold, uint8_t *aboveIso)
+    {
+        if(threshold.kind == IsoThreshold::Compare)
+            SquareClassifier::implementation<PointType>().classifyPoints(&mAllPoints[(y * getResolutionX()) + x], count, threshold.value, aboveIso);
+        else
+            std::fill_n(aboveIso, count, threshold.kind == IsoThreshold::AllAbove ? 1 : 0);
+    }
+
+    //Fill columns [x, x + width) of rows [beginY, endY) from the generator.
+    void generateRows(RowBand &band, const size_t x, const size_t width, const size_t beginY, const size_t endY)
+    {
+        if constexpr(std::is_same_v<PointType, double>)
+            this->mGenerator.getTile(x, beginY, width, endY - beginY, std::span(mAllPoints).subspan((beginY * getResolutionX()) + x), getResolutionX());
+        else
+        {
+            //A few rows at a time through a double buffer, so the whole grid is never held as doubles.
+            for(size_t y = beginY; y < endY; y += GeneratedRows)
+            {
+                const size_t rowCount = std::min(GeneratedRows, endY - y);
+                this->mGenerator.getTile(x, y, width, rowCount, band.generatedPoints, width);
+                for(size_t row = 0; row < rowCount; row++)
+                {
+                    const auto generatedRow = band.generatedPoints.begin() + static_cast<std::ptrdiff_t>(row * width);
+                    std::transform(generatedRow, generatedRow + static_cast<std::ptrdiff_t>(width), mAllPoints.begin() + static_cast<std::ptrdiff_t>(((y + row) * getResolutionX()) + x),
+                                   [this](const double value) { return toPointType(value); });
+                }
+            }
+        }
+    }
+
+    //Regenerate a rectangle of points, split into bands of rows when it's big enough to be worth spreading over the pool.
+    void generatePoints(const SquaresRect &rect)
+    {
+        constexpr size_t MinParallelPoints = 4096;
+        const size_t bandCount = (rect.width * rect.height < MinParallelPoints) ? 1 : std::min(mBands.size(), rect.height);
+        forEachBand(bandCount, [this, &rect, bandCount](const size_t bandIndex)
+        {
+            MS_SCOPED_TIMER(Generate);
+            generateRows(mBands[bandIndex], rect.x, rect.width, rect.y + getBandStart(bandIndex, bandCount, rect.height), rect.y + getBandStart(bandIndex + 1, bandCount, rect.height));
+        });
+        updateBlockBounds(rect);
+    }
+
+    static BlockBounds mergeBounds(const BlockBounds &a, const BlockBounds &b)
+    {
+        return {std::min(a.min, b.min), std::max(a.max, b.max)};
+    }
+
+    //Size the pyramid for the current resolution, the bounds are filled in by the next generatePoints().
+    void resizeBlockLevels()
+    {
+        size_t countX = (getResolutionX() - 2 + BlockSquares) / BlockSquares, countY = (getResolutionY() - 2 + BlockSquares) / BlockSquares;
+        size_t levelCount = 0;
+        for(;; levelCount++)
+        {
+            if(mBlockLevels.size() <= levelCount)
+                mBlockLevels.emplace_back();
+            auto &level = mBlockLevels[levelCount];
+            level.countX = countX;
+            level.countY = countY;
+            level.bounds.resize(countX * countY);
+            if(countX == 1 && countY == 1)
+                break;
+            countX = (countX + 1) / 2;
+            countY = (countY + 1) / 2;
+        }
+        mBlockLevels.resize(levelCount + 1);
+    }
+
+    //Recompute the blocks that use any point of rect, then their parents. A point on the edge of a block is a corner of the blocks either side of it.
+    void updateBlockBounds(const SquaresRect &rect)
+    {
+        auto &blocks = mBlockLevels[0];
+        size_t beginX = (rect.x == 0) ? 0 : (rect.x - 1) / BlockSquares, endX = std::min((rect.x + rect.width - 1) / BlockSquares + 1, blocks.countX);
+        size_t beginY = (rect.y == 0) ? 0 : (rect.y - 1) / BlockSquares, endY = std::min((rect.y + rect.height - 1) / BlockSquares + 1, blocks.countY);
+
+        const size_t blockRows = endY - beginY;
+        const size_t bandCount = ((endX - beginX) * blockRows < 16) ? 1 : std::min(mBands.size(), blockRows);
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            MS_SCOPED_TIMER(Generate);
+            for(size_t blockY = beginY + getBandStart(bandIndex, bandCount, blockRows); blockY < beginY + getBandStart(bandIndex + 1, bandCount, blockRows); blockY++)
+            {
+                const size_t pointsEndY = std::min((blockY + 1) * BlockSquares, getResolutionY() - 1) + 1;
+                for(size_t blockX = beginX; blockX < endX; blockX++)
+                {
+                    const size_t pointsBeginX = blockX * BlockSquares, pointsEndX = std::min((blockX + 1) * BlockSquares, getResolutionX() - 1) + 1;
+                    const auto *row = &mAllPoints[(blockY * BlockSquares * getResolutionX()) + pointsBeginX];
+                    BlockBounds bounds{row[0], row[0]};
+                    for(size_t y = blockY * BlockSquares; y < pointsEndY; y++, row += getResolutionX())
+                    {
+                        const auto [rowMin, rowMax] = std::minmax_element(row, row + (pointsEndX - pointsBeginX));
+                        bounds = mergeBounds(bounds, {*rowMin, *rowMax});
+                    }
+                    blocks.bounds[(blockY * blocks.countX) + blockX] = bounds;
+                }
+            }
+        });
+
+        for(size_t levelIndex = 1; levelIndex < mBlockLevels.size(); levelIndex++)
+        {
+            const auto &children = mBlockLevels[levelIndex - 1];
+            auto &level = mBlockLevels[levelIndex];
+            beginX /= 2; beginY /= 2;
+            endX = (endX + 1) / 2; endY = (endY + 1) / 2;
+            for(size_t blockY = beginY; blockY < endY; blockY++)
+            {
+                for(size_t blockX = beginX; blockX < endX; blockX++)
+                {
+                    const size_t childX = blockX * 2, childY = blockY * 2;
+                    BlockBounds bounds = children.bounds[(childY * children.countX) + childX];
+                    if(childX + 1 < children.countX)
+                        bounds = mergeBounds(bounds, children.bounds[(childY * children.countX) + childX + 1]);
+                    if(childY + 1 < children.countY)
+                    {
+                        bounds = mergeBounds(bounds, children.bounds[((childY + 1) * children.countX) + childX]);
+                        if(childX + 1 < children.countX)
+                            bounds = mergeBounds(bounds, children.bounds[((childY + 1) * children.countX) + childX + 1]);
+                    }
+                    level.bounds[(blockY * level.countX) + blockX] = bounds;
+                }
+            }
+        }
+    }
+
+    static BlockStatus getBlockStatus(const BlockBounds &bounds, const IsoThreshold &threshold)
+    {
+        if(threshold.kind != IsoThreshold::Compare)
+            return threshold.kind == IsoThreshold::AllAbove ? BlockStatus::Above : BlockStatus::Below;
+        if(bounds.min > threshold.value)
+            return BlockStatus::Above;
+        return bounds.max > threshold.value ? BlockStatus::Mixed : BlockStatus::Below;
+    }
+
+    //Split squares [beginX, endX) of a row of blocks into spans by which side of the iso level they're on. Each step takes the biggest
+    //node of the pyramid starting at the current block that's all on one side, so big empty areas are crossed in a few steps.
+    void getBlockSpans(const size_t blockY, const size_t beginX, const size_t endX, const IsoThreshold &threshold, std::vector<BlockSpan> &spans) const
+    {
+        spans.clear();
+        const size_t endBlockX = ((endX - 1) / BlockSquares) + 1;
+        for(size_t blockX = beginX / BlockSquares; blockX < endBlockX; )
+        {
+            size_t levelIndex = mBlockLevels.size() - 1;
+            BlockStatus status = BlockStatus::Mixed;
+            for(;; levelIndex--)
+            {
+                const auto &level = mBlockLevels[levelIndex];
+                if(blockX % (size_t{1} << levelIndex) == 0 || levelIndex == 0)
+                {
+                    status = getBlockStatus(level.bounds[((blockY >> levelIndex) * level.countX) + (blockX >> levelIndex)], threshold);
+                    if(status != BlockStatus::Mixed || levelIndex == 0)
+                        break;
+                }
+            }
+
+            const size_t spanBeginX = std::max(blockX * BlockSquares, beginX);
+            blockX += size_t{1} << levelIndex;
+            const size_t spanEndX = std::min(blockX * BlockSquares, endX);
+            if(!spans.empty() && spans.back().status == status)
+                spans.back().endX = spanEndX;
+            else
+                spans.push_back({spanBeginX, spanEndX, status});
+        }
+    }
+
+    //Size all the buffers for the current resolution. std::vector keeps its capacity, so shrinking the grid never reallocates.
+    void resizeBuffers()
+    {
+        mChunksValid = false;
+        mAllPoints.resize(getResolutionX() * getResolutionY(), 0);
+        for(auto &band : mBands)
+            band.resize(getResolutionX());
+        for(auto &cache : mHorizontalEdgeCache)
+            cache.resize(getResolutionX(), NoVertex);
+        for(auto &cache : mCornerCache)
+            cache.resize(getResolutionX(), NoVertex);
+        mVerticalEdgeCache.resize(getResolutionX(), NoVertex);
+        resizeBlockLevels();
+    }
 
     inline uint8_t getSquareType(const size_t x, const size_t y, const double isoLevel) //Convert a square's four corners to a 4-bit integer. BottomLeft,BottomRight,TopRight,TopLeft with TopLeft being LSB.
     {
@@ -42,6 +476,217 @@ class MarchingSquares
         return squareType;
     }
 
+    //Classify the squares in columns [beginX, endX) of rows [beginY, endY) one row at a time, each grid row is only compared against the iso level once.
+    //rowCallback(y, squareTypes) is called for each row of squares with endX-beginX square types, squareTypes[0] being square beginX.
+    //Only the blocks the iso level passes through are classified, the rest are filled in from the pyramid once per row of blocks.
+    //band.blockSpans holds the spans of the current row, callbacks can use it to skip the squares that are all below (or all above) the iso level.
+    template<typename RowCallback>
+    inline void forEachSquareRow(RowBand &band, const size_t beginX, const size_t endX, const size_t beginY, const size_t endY, const double isoLevel, RowCallback &&rowCallback)
+    {
+        const auto &classifier = SquareClassifier::implementation<PointType>();
+        const auto threshold = getIsoThreshold(isoLevel);
+        auto *topRow = band.pointsAboveIso[0].data();
+        auto *bottomRow = band.pointsAboveIso[1].data();
+        auto *squareTypes = band.squareTypes.data();
+
+        for(size_t blockBeginY = beginY; blockBeginY < endY; )
+        {
+            const size_t blockY = blockBeginY / BlockSquares;
+            const size_t blockEndY = std::min((blockY + 1) * BlockSquares, endY);
+            {
+                MS_SCOPED_TIMER(Classify);
+                getBlockSpans(blockY, beginX, endX, threshold, band.blockSpans);
+                for(const auto &span : band.blockSpans)
+                {
+                    if(span.status == BlockStatus::Mixed)
+                        classifyPoints(span.beginX, blockBeginY, span.endX - span.beginX + 1, threshold, topRow + (span.beginX - beginX));
+                    else //The same for every row of the block
+                        std::fill(squareTypes + (span.beginX - beginX), squareTypes + (span.endX - beginX), span.status == BlockStatus::Above ? 15 : 0);
+                }
+            }
+
+            for(size_t y = blockBeginY; y < blockEndY; y++)
+            {
+                {
+                    MS_SCOPED_TIMER(Classify);
+                    for(const auto &span : band.blockSpans)
+                    {
+                        if(span.status != BlockStatus::Mixed)
+                            continue;
+                        const size_t offset = span.beginX - beginX;
+                        classifyPoints(span.beginX, y+1, span.endX - span.beginX + 1, threshold, bottomRow + offset);
+                        classifier.combineRows(topRow + offset, bottomRow + offset, span.endX - span.beginX, squareTypes + offset);
+                    }
+                }
+                rowCallback(y, static_cast<const uint8_t *>(squareTypes));
+                std::swap(topRow, bottomRow); //This row's bottom points are the next row's top points.
+            }
+            blockBeginY = blockEndY;
+        }
+    }
+
+    //Whole rows of squares
+    template<typename RowCallback>
+    inline void forEachSquareRow(RowBand &band, const size_t beginY, const size_t endY, const double isoLevel, RowCallback &&rowCallback)
+    {
+        forEachSquareRow(band, 0, getResolutionX()-1, beginY, endY, isoLevel, std::forward<RowCallback>(rowCallback));
+    }
+
+    template<typename RowCallback>
+    inline void forEachSquareRow(const double isoLevel, RowCallback &&rowCallback)
+    {
+        forEachSquareRow(mBands[0], 0, getResolutionY()-1, isoLevel, std::forward<RowCallback>(rowCallback));
+    }
+
+    constexpr size_t getChunkCountX() const
+    {
+        return (getResolutionX() - 2 + ChunkSquares) / ChunkSquares; //Rounded up, there are getResolutionX()-1 squares per row
+    }
+
+    constexpr size_t getChunkCountY() const
+    {
+        return (getResolutionY() - 2 + ChunkSquares) / ChunkSquares;
+    }
+
+    //Flag the chunks holding squares [beginX, endX) x [beginY, endY).
+    void markDirtyChunks(const size_t beginX, const size_t endX, const size_t beginY, const size_t endY)
+    {
+        for(size_t chunkY = beginY / ChunkSquares; chunkY <= (endY - 1) / ChunkSquares; chunkY++)
+            for(size_t chunkX = beginX / ChunkSquares; chunkX <= (endX - 1) / ChunkSquares; chunkX++)
+                mDirtyChunks[(chunkY * getChunkCountX()) + chunkX] = 1;
+    }
+
+    //March one chunk for every iso level and hand the vertices to the output.
+    void renderChunk(RowBand &band, const size_t chunkIndex, const std::vector<double> &isoLevels, ISquaresChunkedOutput &output)
+    {
+        const size_t beginX = (chunkIndex % getChunkCountX()) * ChunkSquares;
+        const size_t beginY = (chunkIndex / getChunkCountX()) * ChunkSquares;
+        const size_t endX = std::min(beginX + ChunkSquares, getResolutionX()-1);
+        const size_t endY = std::min(beginY + ChunkSquares, getResolutionY()-1);
+
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            const double isoLevel = isoLevels[isoLevelIndex];
+            band.rowVertices.clear(); //Holds the whole chunk here, it keeps its capacity between chunks
+            forEachSquareRow(band, beginX, endX, beginY, endY, isoLevel, [&](const size_t y, const uint8_t *squareTypes)
+            {
+                MS_SCOPED_TIMER(Interpolate);
+                size_t nonEmptyCells = 0;
+                for(const auto &span : band.blockSpans)
+                {
+                    if(span.status == BlockStatus::Below)
+                        continue;
+                    for(size_t x = span.beginX; x < span.endX; x++)
+                    {
+                        const uint8_t squareType = squareTypes[x - beginX];
+                        if(squareType == 0)
+                            continue;
+
+                        emitSquare(x, y, squareType, isoLevel, getCorners(x, y), band.rowVertices);
+                        nonEmptyCells++;
+                    }
+                }
+                MS_COUNT(CellsVisited, endX - beginX);
+                MS_COUNT(NonEmptyCells, nonEmptyCells);
+            });
+
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, band.rowVertices.size());
+            MS_SCOPED_TIMER(Emit);
+            output.updateChunk(chunkIndex, isoLevelIndex, band.rowVertices);
+        }
+    }
+
+    //Split rowCount rows into bandCount nearly equal bands, returns the first row of band bandIndex.
+    constexpr static size_t getBandStart(const size_t bandIndex, const size_t bandCount, const size_t rowCount)
+    {
+        return (bandIndex * rowCount) / bandCount;
+    }
+
+    //Run bandFunction(bandIndex) for every band, on the thread pool if there is one.
+    template<typename BandFunction>
+    inline void forEachBand(const size_t bandCount, BandFunction &&bandFunction)
+    {
+        if(mThreadPool && bandCount > 1)
+            mThreadPool->parallelFor(bandCount, bandFunction);
+        else
+            for(size_t bandIndex = 0; bandIndex < bandCount; bandIndex++)
+                bandFunction(bandIndex);
+    }
+
+    size_t countBandVerticies(RowBand &band, const size_t beginY, const size_t endY, const double contour)
+    {
+        size_t vertexCount = 0;
+        forEachSquareRow(band, beginY, endY, contour, [&vertexCount, &band](size_t, const uint8_t *squareTypes)
+        {
+            for(const auto &span : band.blockSpans)
+            {
+                if(span.status == BlockStatus::Above) //Full squares all the way, no need to look at them
+                    vertexCount += squareVertexCounts[15] * (span.endX - span.beginX);
+                else if(span.status == BlockStatus::Mixed)
+                    for(size_t x = span.beginX; x < span.endX; x++)
+                        vertexCount += squareVertexCounts[squareTypes[x]];
+            }
+        });
+        return vertexCount;
+    }
+
+    //The four corners of the square at x/y in getSquareType order: TopLeft, TopRight, BottomRight, BottomLeft.
+    inline std::array<double, 4> getCorners(const size_t x, const size_t y)
+    {
+        return {this->getPoint(x, y), this->getPoint(x+1, y), this->getPoint(x+1, y+1), this->getPoint(x, y+1)};
+    }
+
+    //Interpolate the edges of a square and append its triangles to vertices.
+    inline void emitSquare(const size_t x, const size_t y, const uint8_t squareType, const double isoLevel, const std::array<double, 4> &corners, std::vector<SquaresVertex> &vertices)
+    {
+        const auto &[topLeft, topRight, bottomRight, bottomLeft] = corners;
+        std::array<std::tuple<double, double>, 8> interpolated  {
+                                                                    std::make_tuple(0.0, 0.5),
+                                                                    std::make_tuple(0.5, 0.0),
+                                                                    std::make_tuple(0.0, 0.5),
+                                                                    std::make_tuple(0.5, 0.0),
+                                                                    std::make_tuple(0.0, 0.0),
+                                                                    std::make_tuple(0.0, 0.0),
+                                                                    std::make_tuple(0.0, 0.0),
+                                                                    std::make_tuple(0.0, 0.0)
+                                                                };
+
+        if(squareType != 15) //Full squares only use the corners.
+        {
+            std::get<1>(interpolated[0]) = getPixelsPerPointY() * std::abs((isoLevel - topLeft) / (bottomLeft - topLeft));
+            std::get<0>(interpolated[1]) = getPixelsPerPointX() * std::abs((isoLevel - topLeft) / (topRight - topLeft));
+            std::get<1>(interpolated[2]) = getPixelsPerPointY() * std::abs((isoLevel - topRight) / (bottomRight - topRight));
+            std::get<0>(interpolated[3]) = getPixelsPerPointX() * std::abs((isoLevel - bottomLeft) / (bottomRight - bottomLeft));
+        }
+
+        for(int i : squareIndicies[squareType])
+        {
+            if(i == -1) break;
+            auto interTuple =   std::make_tuple(((std::get<0>(squareVerticies[i]) + static_cast<double>(x + mGridOffsetX)) * getPixelsPerPointX()) + (std::get<0>(interpolated[i])),
+                                                ((std::get<1>(squareVerticies[i]) + static_cast<double>(y + mGridOffsetY)) * getPixelsPerPointY()) + (std::get<1>(interpolated[i])) );
+
+            vertices.push_back({static_cast<float>(std::get<0>(interTuple)), static_cast<float>(std::get<1>(interTuple))});
+        }
+    }
+
+    //Position of one of the 8 square vertices (see squareVerticies), same maths as emitSquare() but only for the vertex asked for.
+    inline SquaresVertex getSquareVertex(const int i, const size_t x, const size_t y, const double isoLevel, const std::array<double, 4> &corners)
+    {
+        const auto &[topLeft, topRight, bottomRight, bottomLeft] = corners;
+        double interpolatedX = 0.0, interpolatedY = 0.0;
+        switch(i)
+        {
+        case 0: interpolatedY = getPixelsPerPointY() * std::abs((isoLevel - topLeft) / (bottomLeft - topLeft)); break;
+        case 1: interpolatedX = getPixelsPerPointX() * std::abs((isoLevel - topLeft) / (topRight - topLeft)); break;
+        case 2: interpolatedY = getPixelsPerPointY() * std::abs((isoLevel - topRight) / (bottomRight - topRight)); break;
+        case 3: interpolatedX = getPixelsPerPointX() * std::abs((isoLevel - bottomLeft) / (bottomRight - bottomLeft)); break;
+        default: break;
+        }
+
+        return {static_cast<float>(((std::get<0>(squareVerticies[i]) + static_cast<double>(x + mGridOffsetX)) * getPixelsPerPointX()) + interpolatedX),
+                static_cast<float>(((std::get<1>(squareVerticies[i]) + static_cast<double>(y + mGridOffsetY)) * getPixelsPerPointY()) + interpolatedY)};
+    }
+
     //simple helper function to find if floating point numbers are equal.
     template<typename T>
     inline bool isEqual(T a, T b)
@@ -79,89 +724,651 @@ class MarchingSquares
 
                                                                         }};
 
+    //The contour segments crossing each square type, as pairs of edges (left-0, top-1, right-2, bottom-3). The saddles (5 and 10) are split
+    //the same way as their triangles in squareIndicies so lines follow the edges of the filled regions.
+    constexpr static std::array<std::array<int, 5>, 16> squareSegments {{
+                                                                            /*00*/{-1},
+                                                                            /*01*/{0, 1, -1},
+                                                                            /*02*/{1, 2, -1},
+                                                                            /*03*/{0, 2, -1},
+                                                                            /*04*/{2, 3, -1},
+                                                                            /*05*/{0, 1, 2, 3, -1},
+                                                                            /*06*/{1, 3, -1},
+                                                                            /*07*/{0, 3, -1},
+                                                                            /*08*/{0, 3, -1},
+                                                                            /*09*/{1, 3, -1},
+                                                                            /*10*/{1, 2, 0, 3, -1},
+                                                                            /*11*/{2, 3, -1},
+                                                                            /*12*/{0, 2, -1},
+                                                                            /*13*/{1, 2, -1},
+                                                                            /*14*/{0, 1, -1},
+                                                                            /*15*/{-1}
+                                                                        }};
+
+    //Follow the links from start until the line ends or comes back round to start, appending the crossings to mPolylineVertices.
+    void traceCrossings(const uint32_t start, const bool closed)
+    {
+        const auto firstVertex = static_cast<uint32_t>(mPolylineVertices.size());
+        uint32_t previous = NoVertex, current = start;
+        while(current != NoVertex && !mCrossingVisited[current])
+        {
+            mCrossingVisited[current] = 1;
+            mPolylineVertices.push_back(mMeshVertices[current]);
+            const auto &links = mCrossingLinks[current];
+            const uint32_t next = (links[0] == previous) ? links[1] : links[0];
+            previous = current;
+            current = next;
+        }
+        mPolylines.push_back({firstVertex, static_cast<uint32_t>(mPolylineVertices.size()) - firstVertex, closed});
+    }
 
+    //The first level that isn't below value. Same as std::lower_bound, evenly spaced levels are found by dividing and then nudged to make up for rounding.
+    size_t findIsoLevel(const std::vector<double> &isoLevels, const double value) const
+    {
+        if(!mIsolinesUniform)
+            return static_cast<size_t>(std::lower_bound(isoLevels.begin(), isoLevels.end(), value) - isoLevels.begin());
 
+        const double estimate = std::ceil((value - mIsolineFirst) / mIsolineStep);
+        size_t levelIndex = static_cast<size_t>(std::clamp(estimate, 0.0, static_cast<double>(isoLevels.size())));
+        while(levelIndex > 0 && isoLevels[levelIndex - 1] >= value)
+            levelIndex--;
+        while(levelIndex < isoLevels.size() && isoLevels[levelIndex] < value)
+            levelIndex++;
+        return levelIndex;
+    }
 
-public:
-    MarchingSquares(ISquaresGenerator &generator, ISquaresOutput &output) : mAllPoints(ArraySize, 0), mGenerator(generator), mOutput(output)
+    //Line segments for every level crossing the squares of rows [beginY, endY), bucketed by level in band.levelVertices.
+    //A square is crossed by exactly the levels in [min corner, max corner), so only those levels are looked at. Blocks of the pyramid are skipped
+    //the same way, when no level falls inside their range.
+    void traceBandIsolines(RowBand &band, const size_t beginY, const size_t endY, const std::vector<double> &isoLevels)
+    {
+        band.levelVertices.resize(isoLevels.size());
+        for(auto &levelVertices : band.levelVertices)
+            levelVertices.clear();
+
+        const auto &blocks = mBlockLevels[0];
+        for(size_t y = beginY; y < endY; y++)
+        {
+            MS_SCOPED_TIMER(Interpolate);
+            size_t nonEmptyCells = 0, cellsVisited = 0;
+            const size_t blockY = y / BlockSquares;
+            for(size_t blockX = 0; blockX < blocks.countX; blockX++)
+            {
+                const auto &bounds = blocks.bounds[(blockY * blocks.countX) + blockX];
+                if(findIsoLevel(isoLevels, toDouble(bounds.min)) == findIsoLevel(isoLevels, toDouble(bounds.max)))
+                    continue;
+
+                const size_t endX = std::min((blockX + 1) * BlockSquares, getResolutionX() - 1);
+                cellsVisited += endX - (blockX * BlockSquares);
+                for(size_t x = blockX * BlockSquares; x < endX; x++)
+                {
+                    const std::array<PointType, 4> storedCorners{mAllPoints[(y * getResolutionX()) + x], mAllPoints[(y * getResolutionX()) + x + 1],
+                                                                 mAllPoints[((y+1) * getResolutionX()) + x + 1], mAllPoints[((y+1) * getResolutionX()) + x]};
+                    const auto [minCorner, maxCorner] = std::minmax_element(storedCorners.begin(), storedCorners.end());
+                    const size_t firstLevel = findIsoLevel(isoLevels, toDouble(*minCorner));
+                    const size_t endLevel = findIsoLevel(isoLevels, toDouble(*maxCorner));
+                    if(firstLevel == endLevel)
+                        continue;
+
+                    nonEmptyCells++;
+                    const auto corners = getCorners(x, y);
+                    for(size_t isoLevelIndex = firstLevel; isoLevelIndex < endLevel; isoLevelIndex++)
+                    {
+                        const double isoLevel = isoLevels[isoLevelIndex];
+                        const auto &threshold = mLevelThresholds[isoLevelIndex]; //Same test as the row classifier so all the render paths agree
+                        const auto squareType = static_cast<uint8_t>((isAboveIso(storedCorners[0], threshold) ? 0x1u : 0u) | (isAboveIso(storedCorners[1], threshold) ? 0x2u : 0u) |
+                                                                     (isAboveIso(storedCorners[2], threshold) ? 0x4u : 0u) | (isAboveIso(storedCorners[3], threshold) ? 0x8u : 0u));
+                        const auto &segments = squareSegments[squareType];
+                        for(size_t i = 0; segments[i] != -1; i++)
+                            band.levelVertices[isoLevelIndex].push_back(getSquareVertex(segments[i], x, y, isoLevel, corners));
+                    }
+                }
+            }
+            MS_COUNT(CellsVisited, cellsVisited);
+            MS_COUNT(NonEmptyCells, nonEmptyCells);
+        }
+    }
+
+    //How many vertices each square type emits, worked out from squareIndicies at compile time.
+    constexpr static std::array<uint8_t, 16> squareVertexCounts = []()
+    {
+        std::array<uint8_t, 16> counts{};
+        for(size_t squareType = 0; squareType < 16; squareType++)
+            while(squareIndicies[squareType][counts[squareType]] != -1)
+                counts[squareType]++;
+        return counts;
+    }();
+
+
+
+
+    MarchingSquares(ISquaresGenerator &generator, ISquaresOutput *output, ISquaresChunkedOutput *chunkedOutput,
+                    size_t resolutionX, size_t resolutionY, size_t pixelsPerPointX, size_t pixelsPerPointY) : mResolutionX(resolutionX), mResolutionY(resolutionY),
+                                                                                                            mPixelsPerPointX(pixelsPerPointX), mPixelsPerPointY(pixelsPerPointY),
+                                                                                                            mBands(1),
+                                                                                                            mGenerator(generator), mOutput(output), mChunkedOutput(chunkedOutput)
     {
+        resizeBuffers();
         recalculate(); //Calculate the first frame
     }
 
+public:
+    //The sizes only need to be passed for dimensions that are std::dynamic_extent, fixed ones ignore them.
+    //render() and renderSinglePass() write to output.
+    MarchingSquares(ISquaresGenerator &generator, ISquaresOutput &output,
+                    size_t resolutionX = ResolutionX, size_t resolutionY = ResolutionY,
+                    size_t pixelsPerPointX = PixelsPerPointX, size_t pixelsPerPointY = PixelsPerPointY) : MarchingSquares(generator, &output, nullptr,
+                                                                                                                          resolutionX, resolutionY, pixelsPerPointX, pixelsPerPointY)
+    {}
+
+    //update() writes to output.
+    MarchingSquares(ISquaresGenerator &generator, ISquaresChunkedOutput &output,
+                    size_t resolutionX = ResolutionX, size_t resolutionY = ResolutionY,
+                    size_t pixelsPerPointX = PixelsPerPointX, size_t pixelsPerPointY = PixelsPerPointY) : MarchingSquares(generator, nullptr, &output,
+                                                                                                                          resolutionX, resolutionY, pixelsPerPointX, pixelsPerPointY)
+    {}
+
+    constexpr size_t getResolutionX() const
+    {
+        if constexpr(ResolutionX == std::dynamic_extent) return mResolutionX; else return ResolutionX;
+    }
+
+    constexpr size_t getResolutionY() const
+    {
+        if constexpr(ResolutionY == std::dynamic_extent) return mResolutionY; else return ResolutionY;
+    }
+
+    constexpr size_t getPixelsPerPointX() const
+    {
+        if constexpr(PixelsPerPointX == std::dynamic_extent) return mPixelsPerPointX; else return PixelsPerPointX;
+    }
+
+    constexpr size_t getPixelsPerPointY() const
+    {
+        if constexpr(PixelsPerPointY == std::dynamic_extent) return mPixelsPerPointY; else return PixelsPerPointY;
+    }
+
+    //Change the number of points in the grid and recalculate them. Buffers are reused, they only reallocate when the grid grows.
+    void resize(const size_t resolutionX, const size_t resolutionY) requires (ResolutionX == std::dynamic_extent && ResolutionY == std::dynamic_extent)
+    {
+        mResolutionX = resolutionX;
+        mResolutionY = resolutionY;
+        resizeBuffers();
+        setThreadPool(mThreadPool); //The number of bands depends on the number of rows
+        recalculate();
+    }
+
+    //Shift the output by a whole number of points, e.g. to place a band of a larger grid where it belongs.
+    void setGridOffset(const size_t pointX, const size_t pointY)
+    {
+        mChunksValid = mChunksValid && pointX == mGridOffsetX && pointY == mGridOffsetY; //Every vertex moves
+        mGridOffsetX = pointX;
+        mGridOffsetY = pointY;
+    }
+
+    void setPixelsPerPoint(const size_t pixelsPerPointX, const size_t pixelsPerPointY) requires (PixelsPerPointX == std::dynamic_extent && PixelsPerPointY == std::dynamic_extent)
+    {
+        mChunksValid = mChunksValid && pixelsPerPointX == mPixelsPerPointX && pixelsPerPointY == mPixelsPerPointY;
+        mPixelsPerPointX = pixelsPerPointX;
+        mPixelsPerPointY = pixelsPerPointY;
+    }
+
+    //Split recalculate() and render() into bands of rows that run in parallel on the pool, nullptr goes back to single threaded.
+    //The output is identical either way.
+    void setThreadPool(ThreadPool *threadPool)
+    {
+        mThreadPool = threadPool;
+        const size_t bandCount = threadPool ? std::min(threadPool->getThreadCount() * 4, getResolutionY()-1) : 1; //A few bands per thread to even out the load
+        mBands.resize(std::max<size_t>(bandCount, 1));
+        for(auto &band : mBands)
+            band.resize(getResolutionX());
+    }
+
     void recalculate()
     {
-        for(size_t y = 0; y < ResolutionY; y++)
-            for(size_t x = 0; x < ResolutionX; x++)
-                mAllPoints[(y * ResolutionX) + x] = this->mGenerator.getPoint(x, y); //Use the generator to generate all the points in a frame
+        //Use the generator to generate all the points in a frame, one tile per band
+        generatePoints({0, 0, getResolutionX(), getResolutionY()});
+    }
+
+    //Squares per side of an update() chunk
+    constexpr static size_t ChunkSquares = 32;
+
+    //Incremental recalculate() + render() for grids constructed with an ISquaresChunkedOutput. The generator's dirty rectangles are regenerated and
+    //only the chunks of squares that use those points (a changed point touches the squares on both sides of it) are marched again and replaced. Generators that don't report
+    //dirty rectangles get a full recalculate() and every chunk is rewritten, same as render().
+    //Don't mix this with recalculate() on the same grid, update() can't tell which points recalculate() changed.
+    //Returns the number of chunks that were written.
+    size_t update(const std::vector<double> &isoLevels)
+    {
+        if(!mChunkedOutput)
+            throw std::logic_error("update() needs a MarchingSquares constructed with an ISquaresChunkedOutput");
+        auto &output = *mChunkedOutput;
+        mDirtyRects.clear();
+        const bool dirtyRectsKnown = mGenerator.getDirtyRects(mDirtyRects); //Always asked, so the generator starts tracking from now
+
+        const size_t chunkCount = getChunkCountX() * getChunkCountY();
+        const bool rewriteAll = !mChunksValid || mChunkIsoLevels != isoLevels;
+        if(rewriteAll)
+        {
+            output.resetChunks(getChunkCountX(), getChunkCountY(), isoLevels);
+            mChunkIsoLevels = isoLevels;
+            mChunksValid = true;
+        }
+        mDirtyChunks.assign(chunkCount, rewriteAll ? 1 : 0);
+
+        if(!dirtyRectsKnown)
+        {
+            recalculate();
+            std::fill(mDirtyChunks.begin(), mDirtyChunks.end(), 1);
+        }
+        else
+        {
+            for(auto rect : mDirtyRects)
+            {
+                rect.width = std::min(rect.x + rect.width, getResolutionX()) - std::min(rect.x, getResolutionX());
+                rect.height = std::min(rect.y + rect.height, getResolutionY()) - std::min(rect.y, getResolutionY());
+                if(rect.width == 0 || rect.height == 0)
+                    continue;
+
+                generatePoints(rect);
+                markDirtyChunks(rect.x > 0 ? rect.x - 1 : 0, std::min(rect.x + rect.width, getResolutionX()-1),
+                                rect.y > 0 ? rect.y - 1 : 0, std::min(rect.y + rect.height, getResolutionY()-1));
+            }
+        }
+
+        mDirtyChunkList.clear();
+        for(size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+            if(mDirtyChunks[chunkIndex])
+                mDirtyChunkList.push_back(chunkIndex);
+
+        //Each band marches a share of the dirty chunks with its own scratch space.
+        const size_t bandCount = std::min(mBands.size(), mDirtyChunkList.size());
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            const size_t begin = getBandStart(bandIndex, bandCount, mDirtyChunkList.size());
+            const size_t end = getBandStart(bandIndex + 1, bandCount, mDirtyChunkList.size());
+            for(size_t i = begin; i < end; i++)
+                renderChunk(mBands[bandIndex], mDirtyChunkList[i], isoLevels, output);
+        });
+        return mDirtyChunkList.size();
     }
 
-    std::vector<double> &getAllPoints()
+    //Points as they are stored, see PointType. Call pointsChanged() after editing them.
+    std::vector<PointType> &getAllPoints()
     {
         return mAllPoints;
     }
 
+    //Refresh the min/max pyramid for points edited through getAllPoints(), otherwise blocks could be skipped using their old range.
+    void pointsChanged(const SquaresRect &rect)
+    {
+        updateBlockBounds(rect);
+    }
+
     //return a point at x/y
     constexpr inline double getPoint(const size_t x, const size_t y)
     {
-        return mAllPoints[(y * ResolutionX) + x];
+        return toDouble(mAllPoints[(y * getResolutionX()) + x]);
     }
 
-    //count total lines in a frame before rendering. Saves on 1000s of memory/copy operations on the VertexArray.
-    constexpr size_t countVerticies(const double contour)
+    //Set how generator values map onto quantized points: point = round((value - offset) / scale), clamped to the integer range.
+    //Values that only need 0-1 can keep the default. Takes effect on the next recalculate().
+    void setQuantization(const double scale, const double offset) requires std::is_integral_v<PointType>
     {
+        mQuantizationScale = scale;
+        mQuantizationOffset = offset;
+    }
+
+    //count the vertices render() emits for one iso level. Used to size the output buffer once, which saves on 1000s of memory/copy operations on the VertexArray.
+    size_t countVerticies(const double contour)
+    {
+        return countBandVerticies(mBands[0], 0, getResolutionY()-1, contour);
+    }
+
+    size_t render(const std::vector<double> &isoLevels)
+    {
+        if(!mOutput)
+            throw std::logic_error("render() needs a MarchingSquares constructed with an ISquaresOutput");
+        const size_t bandCount = mBands.size();
+
+        //Count pass, every band counts its own vertices for each iso level.
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            auto &band = mBands[bandIndex];
+            const size_t beginY = getBandStart(bandIndex, bandCount, getResolutionY()-1);
+            const size_t endY = getBandStart(bandIndex + 1, bandCount, getResolutionY()-1);
+
+            band.firstVertex.resize(isoLevels.size());
+            for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+                band.firstVertex[isoLevelIndex] = countBandVerticies(band, beginY, endY, isoLevels[isoLevelIndex]);
+        });
+
+        //Exclusive prefix sum over (iso level, band) turns the counts into fixed output slots, in the same order as a single band would write them.
         size_t vertexCount = 0;
-        for(size_t y = 0; y < ResolutionY-1; y++)
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
         {
-            for(size_t x = 0; x < ResolutionX-1; x++)
+            [[maybe_unused]] const size_t levelFirstVertex = vertexCount;
+            for(auto &band : mBands)
             {
-                uint8_t squareType = getSquareType(x, y, contour);
-                if(squareType > 0 && squareType < 15)
-                    vertexCount += (squareType == 5 || squareType == 10) ? 4 : 2;
+                const size_t bandVertexCount = band.firstVertex[isoLevelIndex];
+                band.firstVertex[isoLevelIndex] = vertexCount;
+                vertexCount += bandVertexCount;
             }
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, vertexCount - levelFirstVertex);
         }
+
+        mOutput->setIsoLevels(isoLevels);
+        mOutput->resetVertices(vertexCount); //Exact size, so the output never has to grow while the vertices are written.
+
+        //Emit pass, bands write into their own slots so no locking is needed.
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            auto &band = mBands[bandIndex];
+            const size_t beginY = getBandStart(bandIndex, bandCount, getResolutionY()-1);
+            const size_t endY = getBandStart(bandIndex + 1, bandCount, getResolutionY()-1);
+
+            for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+            {
+                const double isoLevel = isoLevels[isoLevelIndex];
+                size_t currentVertex = band.firstVertex[isoLevelIndex];
+                forEachSquareRow(band, beginY, endY, isoLevel, [&](const size_t y, const uint8_t *squareTypes)
+                {
+                    band.rowVertices.clear();
+                    {
+                        MS_SCOPED_TIMER(Interpolate);
+                        size_t nonEmptyCells = 0;
+                        for(const auto &span : band.blockSpans)
+                        {
+                            if(span.status == BlockStatus::Below)
+                                continue;
+                            for(size_t x = span.beginX; x < span.endX; x++)
+                            {
+                                const uint8_t squareType = squareTypes[x];
+                                if(squareType == 0) //Nothing to draw, skip the interpolation entirely.
+                                    continue;
+
+                                emitSquare(x, y, squareType, isoLevel, getCorners(x, y), band.rowVertices);
+                                nonEmptyCells++;
+                            }
+                        }
+                        MS_COUNT(CellsVisited, getResolutionX()-1);
+                        MS_COUNT(NonEmptyCells, nonEmptyCells);
+                    }
+
+                    MS_SCOPED_TIMER(Emit);
+                    mOutput->writeVertices(currentVertex, isoLevelIndex, band.rowVertices); //One call per row instead of one per vertex
+                    currentVertex += band.rowVertices.size();
+                });
+            }
+        });
         return vertexCount;
     }
-    size_t render(const std::vector<double> isoLevels)
+
+    //Same output as render(), but the grid is only walked once no matter how many iso levels there are.
+    //Each square's corners are loaded once and reused for every level, the vertices are collected per level and then written level by level
+    //so the output is still grouped by iso level.
+    size_t renderSinglePass(const std::vector<double> &isoLevels)
     {
-        mOutput.resetVertices(0);
+        if(!mOutput)
+            throw std::logic_error("renderSinglePass() needs a MarchingSquares constructed with an ISquaresOutput");
+        mLevelVertices.resize(isoLevels.size());
+        for(auto &levelVertices : mLevelVertices)
+            levelVertices.clear(); //Keeps the capacity from the previous frame
+        mLevelThresholds.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mLevelThresholds.begin(), [this](const double isoLevel) { return getIsoThreshold(isoLevel); });
+
+        for(size_t y = 0; y < getResolutionY()-1; y++)
+        {
+            MS_SCOPED_TIMER(Interpolate); //Classification is mixed in with the interpolation here, so it all counts as interpolation
+            size_t nonEmptyCells = 0;
+            for(size_t x = 0; x < getResolutionX()-1; x++)
+            {
+                const auto corners = getCorners(x, y);
+                const std::array<PointType, 4> storedCorners{mAllPoints[(y * getResolutionX()) + x], mAllPoints[(y * getResolutionX()) + x + 1],
+                                                             mAllPoints[((y+1) * getResolutionX()) + x + 1], mAllPoints[((y+1) * getResolutionX()) + x]};
+                for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+                {
+                    const double isoLevel = isoLevels[isoLevelIndex];
+                    const auto &threshold = mLevelThresholds[isoLevelIndex]; //Same test as the row classifier so both render paths agree
+                    const auto squareType = static_cast<uint8_t>((isAboveIso(storedCorners[0], threshold) ? 0x1u : 0u) | (isAboveIso(storedCorners[1], threshold) ? 0x2u : 0u) |
+                                                                 (isAboveIso(storedCorners[2], threshold) ? 0x4u : 0u) | (isAboveIso(storedCorners[3], threshold) ? 0x8u : 0u));
+                    if(squareType != 0)
+                    {
+                        emitSquare(x, y, squareType, isoLevel, corners, mLevelVertices[isoLevelIndex]);
+                        nonEmptyCells++;
+                    }
+                }
+            }
+            MS_COUNT(CellsVisited, (getResolutionX()-1) * isoLevels.size());
+            MS_COUNT(NonEmptyCells, nonEmptyCells);
+        }
+
+        size_t vertexCount = 0;
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            vertexCount += mLevelVertices[isoLevelIndex].size();
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, mLevelVertices[isoLevelIndex].size());
+        }
+
+        MS_SCOPED_TIMER(Emit);
+        mOutput->setIsoLevels(isoLevels);
+        mOutput->resetVertices(vertexCount);
         size_t currentVertex = 0;
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            mOutput->writeVertices(currentVertex, isoLevelIndex, mLevelVertices[isoLevelIndex]);
+            currentVertex += mLevelVertices[isoLevelIndex].size();
+        }
+        return currentVertex;
+    }
 
-        std::array<std::tuple<double, double>, 8> interpolated  {
-                                                                    std::make_tuple(0.0, 0.5),
-                                                                    std::make_tuple(0.5, 0.0),
-                                                                    std::make_tuple(0.0, 0.5),
-                                                                    std::make_tuple(0.5, 0.0),
-                                                                    std::make_tuple(0.0, 0.0),
-                                                                    std::make_tuple(0.0, 0.0),
-                                                                    std::make_tuple(0.0, 0.0),
-                                                                    std::make_tuple(0.0, 0.0)
-                                                                };
+    //Contour lines for lots of iso levels at once, e.g. a topographic map with hundreds of them. isoLevels has to be sorted from lowest to highest.
+    //Each square only works on the levels between its lowest and highest corner, so the cost follows the number of crossings and not squares x levels.
+    //The output gets pairs of vertices, one line segment each (draw them as a line list), grouped by iso level like render().
+    //Returns the number of vertices.
+    size_t renderIsolines(const std::vector<double> &isoLevels)
+    {
+        if(!mOutput)
+            throw std::logic_error("renderIsolines() needs a MarchingSquares constructed with an ISquaresOutput");
+        if(!std::is_sorted(isoLevels.begin(), isoLevels.end()))
+            throw std::invalid_argument("renderIsolines() needs the iso levels in ascending order");
+
+        mLevelThresholds.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mLevelThresholds.begin(), [this](const double isoLevel) { return getIsoThreshold(isoLevel); });
+        mIsolinesUniform = isoLevels.size() > 2;
+        if(mIsolinesUniform)
+        {
+            mIsolineFirst = isoLevels.front();
+            mIsolineStep = (isoLevels.back() - isoLevels.front()) / static_cast<double>(isoLevels.size() - 1);
+            for(size_t i = 1; i < isoLevels.size() && mIsolinesUniform; i++)
+                mIsolinesUniform = std::abs(isoLevels[i] - (mIsolineFirst + (mIsolineStep * static_cast<double>(i)))) <= mIsolineStep * 1e-6;
+            mIsolinesUniform = mIsolinesUniform && mIsolineStep > 0.0;
+        }
+
+        const size_t bandCount = mBands.size();
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            traceBandIsolines(mBands[bandIndex], getBandStart(bandIndex, bandCount, getResolutionY()-1), getBandStart(bandIndex + 1, bandCount, getResolutionY()-1), isoLevels);
+        });
+
+        //Same slot layout as render(), level by level and band by band within a level.
+        size_t vertexCount = 0;
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            [[maybe_unused]] const size_t levelFirstVertex = vertexCount;
+            for(auto &band : mBands)
+            {
+                band.firstVertex.resize(isoLevels.size());
+                band.firstVertex[isoLevelIndex] = vertexCount;
+                vertexCount += band.levelVertices[isoLevelIndex].size();
+            }
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, vertexCount - levelFirstVertex);
+        }
+
+        mOutput->setIsoLevels(isoLevels);
+        mOutput->resetVertices(vertexCount);
+        forEachBand(bandCount, [&](const size_t bandIndex)
+        {
+            MS_SCOPED_TIMER(Emit);
+            auto &band = mBands[bandIndex];
+            for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+                if(!band.levelVertices[isoLevelIndex].empty())
+                    mOutput->writeVertices(band.firstVertex[isoLevelIndex], isoLevelIndex, band.levelVertices[isoLevelIndex]);
+        });
+        return vertexCount;
+    }
+
+    //Indexed version of render(). Every edge crossing and corner is interpolated once and shared between the squares that use it,
+    //using rolling per-row caches, so each iso level becomes a mesh of unique vertices plus a triangle index buffer.
+    //Returns the total number of indices.
+    size_t renderIndexed(const std::vector<double> &isoLevels, ISquaresIndexedOutput &output)
+    {
+        output.resetMeshes(isoLevels);
+        size_t indexCount = 0;
 
-        for(const auto isoLevel : isoLevels)
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
         {
-            for(size_t y = 0; y < ResolutionY-1; y++)
+            const double isoLevel = isoLevels[isoLevelIndex];
+            mMeshVertices.clear();
+            mMeshIndices.clear();
+
+            auto *topEdges = &mHorizontalEdgeCache[0], *bottomEdges = &mHorizontalEdgeCache[1];
+            auto *topCorners = &mCornerCache[0], *bottomCorners = &mCornerCache[1];
+            std::fill(topEdges->begin(), topEdges->end(), NoVertex);
+            std::fill(topCorners->begin(), topCorners->end(), NoVertex);
+
+            forEachSquareRow(isoLevel, [&](const size_t y, const uint8_t *squareTypes)
             {
-                for(size_t x = 0; x < ResolutionX-1; x++)
+                MS_SCOPED_TIMER(Interpolate);
+                size_t nonEmptyCells = 0;
+                std::fill(bottomEdges->begin(), bottomEdges->end(), NoVertex);
+                std::fill(bottomCorners->begin(), bottomCorners->end(), NoVertex);
+                std::fill(mVerticalEdgeCache.begin(), mVerticalEdgeCache.end(), NoVertex);
+
+                for(const auto &span : mBands[0].blockSpans)
                 {
-                    const uint8_t squareType = getSquareType(x, y, isoLevel);
+                    if(span.status == BlockStatus::Below)
+                        continue;
+                    for(size_t x = span.beginX; x < span.endX; x++)
+                    {
+                        const uint8_t squareType = squareTypes[x];
+                        if(squareType == 0)
+                            continue;
+
+                        nonEmptyCells++;
+                        const auto corners = getCorners(x, y);
+                                                                    //left-0                      top-1                   right-2                         bottom-3
+                                                                    //topLeft-4                   topRight-5              bottomRight-6                   bottomLeft-7
+                        const std::array<uint32_t *, 8> cached {    &mVerticalEdgeCache[x],       &(*topEdges)[x],        &mVerticalEdgeCache[x+1],       &(*bottomEdges)[x],
+                                                                    &(*topCorners)[x],            &(*topCorners)[x+1],    &(*bottomCorners)[x+1],         &(*bottomCorners)[x]};
+                        for(int i : squareIndicies[squareType])
+                        {
+                            if(i == -1) break;
+                            uint32_t &vertexIndex = *cached[i];
+                            if(vertexIndex == NoVertex)
+                            {
+                                vertexIndex = static_cast<uint32_t>(mMeshVertices.size());
+                                mMeshVertices.push_back(getSquareVertex(i, x, y, isoLevel, corners));
+                            }
+                            mMeshIndices.push_back(vertexIndex);
+                        }
+                    }
+                }
+
+                std::swap(topEdges, bottomEdges); //This row's bottom is the next row's top
+                std::swap(topCorners, bottomCorners);
+                MS_COUNT(CellsVisited, getResolutionX()-1);
+                MS_COUNT(NonEmptyCells, nonEmptyCells);
+            });
+
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, mMeshVertices.size());
+            MS_SCOPED_TIMER(Emit);
+            output.addMesh(isoLevelIndex, mMeshVertices, mMeshIndices);
+            indexCount += mMeshIndices.size();
+        }
+        return indexCount;
+    }
+
+    //Contour lines instead of filled triangles. Squares are walked like renderIndexed(), each crossing gets one vertex through the edge caches
+    //and is linked to the crossing at the other end of each segment it's part of. A crossing belongs to at most two squares, so following the links
+    //stitches the segments into polylines in linear time. Lines that run off the grid are open, everything else is closed.
+    //Returns the total number of vertices.
+    size_t renderPolylines(const std::vector<double> &isoLevels, ISquaresPolylineOutput &output)
+    {
+        output.resetPolylines(isoLevels);
+        size_t vertexCount = 0;
 
-                    std::get<1>(interpolated[0]) = PixelsPerPointY * std::abs((isoLevel - this->getPoint(x, y)) / (this->getPoint(x, y+1) - this->getPoint(x, y)));
-                    std::get<0>(interpolated[1]) = PixelsPerPointX * std::abs((isoLevel - this->getPoint(x, y)) / (this->getPoint(x+1, y) - this->getPoint(x, y)));
-                    std::get<1>(interpolated[2]) = PixelsPerPointY * std::abs((isoLevel - this->getPoint(x+1, y)) / (this->getPoint(x+1, y+1) - this->getPoint(x+1, y)));
-                    std::get<0>(interpolated[3]) = PixelsPerPointX * std::abs((isoLevel - this->getPoint(x, y+1)) / (this->getPoint(x+1, y+1) - this->getPoint(x, y+1)));
+        for(size_t isoLevelIndex = 0; isoLevelIndex < isoLevels.size(); isoLevelIndex++)
+        {
+            const double isoLevel = isoLevels[isoLevelIndex];
+            mMeshVertices.clear();
+            mCrossingLinks.clear();
+
+            auto *topEdges = &mHorizontalEdgeCache[0], *bottomEdges = &mHorizontalEdgeCache[1];
+            std::fill(topEdges->begin(), topEdges->end(), NoVertex);
+
+            forEachSquareRow(isoLevel, [&](const size_t y, const uint8_t *squareTypes)
+            {
+                MS_SCOPED_TIMER(Interpolate);
+                size_t nonEmptyCells = 0;
+                std::fill(bottomEdges->begin(), bottomEdges->end(), NoVertex);
+                std::fill(mVerticalEdgeCache.begin(), mVerticalEdgeCache.end(), NoVertex);
 
-                    for(int i : squareIndicies[squareType])
+                for(const auto &span : mBands[0].blockSpans) //No lines cross squares that are all above or below
+                {
+                    if(span.status != BlockStatus::Mixed)
+                        continue;
+                    for(size_t x = span.beginX; x < span.endX; x++)
                     {
-                        if(i == -1) break;
-                        auto interTuple =   std::make_tuple(((std::get<0>(squareVerticies[i]) + static_cast<double>(x)) * PixelsPerPointX) + (std::get<0>(interpolated[i])),
-                                                            ((std::get<1>(squareVerticies[i]) + static_cast<double>(y)) * PixelsPerPointY) + (std::get<1>(interpolated[i])) );
+                        const uint8_t squareType = squareTypes[x];
+                        if(squareType == 0 || squareType == 15)
+                            continue;
+
+                        nonEmptyCells++;
+                        const auto corners = getCorners(x, y);
+                        const std::array<uint32_t *, 4> cached { &mVerticalEdgeCache[x], &(*topEdges)[x], &mVerticalEdgeCache[x+1], &(*bottomEdges)[x] };
+                        const auto getCrossing = [&](const int edge)
+                        {
+                            uint32_t &vertexIndex = *cached[edge];
+                            if(vertexIndex == NoVertex)
+                            {
+                                vertexIndex = static_cast<uint32_t>(mMeshVertices.size());
+                                mMeshVertices.push_back(getSquareVertex(edge, x, y, isoLevel, corners));
+                                mCrossingLinks.push_back({NoVertex, NoVertex});
+                            }
+                            return vertexIndex;
+                        };
 
-                        mOutput.addVertex(isoLevel, std::get<0>(interTuple), std::get<1>(interTuple));
-                        currentVertex++;
+                        const auto &segments = squareSegments[squareType];
+                        for(size_t i = 0; segments[i] != -1; i += 2)
+                        {
+                            const uint32_t from = getCrossing(segments[i]), to = getCrossing(segments[i+1]);
+                            mCrossingLinks[from][mCrossingLinks[from][0] == NoVertex ? 0 : 1] = to;
+                            mCrossingLinks[to][mCrossingLinks[to][0] == NoVertex ? 0 : 1] = from;
+                        }
                     }
                 }
-            }
+
+                std::swap(topEdges, bottomEdges); //This row's bottom is the next row's top
+                MS_COUNT(CellsVisited, getResolutionX()-1);
+                MS_COUNT(NonEmptyCells, nonEmptyCells);
+            });
+
+            MS_SCOPED_TIMER(Emit);
+            mPolylineVertices.clear();
+            mPolylines.clear();
+            mCrossingVisited.assign(mMeshVertices.size(), 0);
+            for(uint32_t crossing = 0; crossing < mMeshVertices.size(); crossing++) //Open lines first, from the end they're found at
+                if(mCrossingLinks[crossing][1] == NoVertex && !mCrossingVisited[crossing])
+                    traceCrossings(crossing, false);
+            for(uint32_t crossing = 0; crossing < mMeshVertices.size(); crossing++) //Only loops are left
+                if(!mCrossingVisited[crossing])
+                    traceCrossings(crossing, true);
+
+            MS_COUNT_LEVEL_VERTICES(isoLevelIndex, mPolylineVertices.size());
+            output.addPolylines(isoLevelIndex, mPolylineVertices, mPolylines);
+            vertexCount += mPolylineVertices.size();
         }
-        return currentVertex;
+        return vertexCount;
     }
 };
@@ -77,6 +77,24 @@ namespace siv
 			return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 		}
 
+		// Same as Grad(), written as selects and sign multiplies so batched loops can vectorize it
+		[[nodiscard]]
+		static constexpr value_type GradBranchless(std::uint8_t hash, value_type x, value_type y, value_type z) noexcept
+		{
+			const std::int32_t h = hash & 15;
+			const value_type u = h < 8 ? x : y;
+			const value_type v = h < 4 ? y : ((h == 12) | (h == 14)) ? x : z;
+			return u * static_cast<value_type>(1 - ((h & 1) << 1)) + v * static_cast<value_type>(1 - (h & 2));
+		}
+
+		// Same as std::floor() for values within the int32 range, without a library call
+		[[nodiscard]]
+		static constexpr value_type Floor(value_type x) noexcept
+		{
+			const value_type truncated = static_cast<value_type>(static_cast<std::int32_t>(x));
+			return truncated - static_cast<value_type>(truncated > x ? 1 : 0);
+		}
+
 		[[nodiscard]]
 		static constexpr value_type Weight(std::int32_t octaves) noexcept
 		{
@@ -92,8 +110,67 @@ namespace siv
 			return value;
 		}
 
+		// Evaluates noise3D() for BatchSize samples. Each step is a separate loop over the lanes so
+		// the fade, lerp and gradient math can be vectorized, only the permutation lookups stay scalar.
+		void noise3DBatch(const value_type* xs, const value_type* ys, const value_type* zs, value_type* result) const noexcept
+		{
+			std::int32_t A[BatchSize], B[BatchSize], Z[BatchSize];
+			value_type x[BatchSize], y[BatchSize], z[BatchSize];
+
+			for (std::size_t i = 0; i < BatchSize; ++i)
+			{
+				const value_type floorX = Floor(xs[i]);
+				const value_type floorY = Floor(ys[i]);
+				const value_type floorZ = Floor(zs[i]);
+
+				A[i] = static_cast<std::int32_t>(floorX) & 255;
+				B[i] = static_cast<std::int32_t>(floorY) & 255;
+				Z[i] = static_cast<std::int32_t>(floorZ) & 255;
+
+				x[i] = xs[i] - floorX;
+				y[i] = ys[i] - floorY;
+				z[i] = zs[i] - floorZ;
+			}
+
+			std::uint8_t hash[8][BatchSize];
+
+			for (std::size_t i = 0; i < BatchSize; ++i)
+			{
+				const std::int32_t a = p[A[i]] + B[i], aa = p[a] + Z[i], ab = p[a + 1] + Z[i];
+				const std::int32_t b = p[A[i] + 1] + B[i], ba = p[b] + Z[i], bb = p[b + 1] + Z[i];
+
+				hash[0][i] = p[aa];
+				hash[1][i] = p[ba];
+				hash[2][i] = p[ab];
+				hash[3][i] = p[bb];
+				hash[4][i] = p[aa + 1];
+				hash[5][i] = p[ba + 1];
+				hash[6][i] = p[ab + 1];
+				hash[7][i] = p[bb + 1];
+			}
+
+			for (std::size_t i = 0; i < BatchSize; ++i)
+			{
+				const value_type u = Fade(x[i]);
+				const value_type v = Fade(y[i]);
+				const value_type w = Fade(z[i]);
+
+				result[i] = Lerp(w, Lerp(v, Lerp(u, GradBranchless(hash[0][i], x[i], y[i], z[i]),
+					GradBranchless(hash[1][i], x[i] - 1, y[i], z[i])),
+					Lerp(u, GradBranchless(hash[2][i], x[i], y[i] - 1, z[i]),
+					GradBranchless(hash[3][i], x[i] - 1, y[i] - 1, z[i]))),
+					Lerp(v, Lerp(u, GradBranchless(hash[4][i], x[i], y[i], z[i] - 1),
+					GradBranchless(hash[5][i], x[i] - 1, y[i], z[i] - 1)),
+					Lerp(u, GradBranchless(hash[6][i], x[i], y[i] - 1, z[i] - 1),
+					GradBranchless(hash[7][i], x[i] - 1, y[i] - 1, z[i] - 1))));
+			}
+		}
+
 	public:
 
+		// Number of samples the batched functions evaluate per step
+		static constexpr std::size_t BatchSize = (sizeof(value_type) <= 4) ? 8 : 4;
+
 	# if __has_cpp_attribute(nodiscard) >= 201907L
 		[[nodiscard]]
 	# endif
@@ -350,6 +427,75 @@ namespace siv
 				* value_type(0.5) + value_type(0.5);
 		}
 
+		///////////////////////////////////////
+		//
+		//	Batched noise
+		//	* Evaluates count samples from separate coordinate arrays
+		//	* Matches the single sample functions as long as coordinates stay within the int32 range
+		//
+		void noise3D(const value_type* x, const value_type* y, const value_type* z, value_type* result, std::size_t count) const noexcept
+		{
+			std::size_t i = 0;
+
+			for (; i + BatchSize <= count; i += BatchSize)
+			{
+				noise3DBatch(x + i, y + i, z + i, result + i);
+			}
+
+			if (i < count)
+			{
+				value_type bx[BatchSize] = {}, by[BatchSize] = {}, bz[BatchSize] = {}, br[BatchSize];
+				std::copy(x + i, x + count, bx);
+				std::copy(y + i, y + count, by);
+				std::copy(z + i, z + count, bz);
+				noise3DBatch(bx, by, bz, br);
+				std::copy(br, br + (count - i), result + i);
+			}
+		}
+
+		void accumulatedOctaveNoise3D(const value_type* x, const value_type* y, const value_type* z, std::int32_t octaves, value_type* result, std::size_t count) const noexcept
+		{
+			for (std::size_t i = 0; i < count; i += BatchSize)
+			{
+				const std::size_t n = std::min(BatchSize, count - i);
+				value_type bx[BatchSize] = {}, by[BatchSize] = {}, bz[BatchSize] = {}, octave[BatchSize];
+				value_type sum[BatchSize] = {};
+				value_type amp = 1;
+
+				std::copy(x + i, x + i + n, bx);
+				std::copy(y + i, y + i + n, by);
+				std::copy(z + i, z + i + n, bz);
+
+				for (std::int32_t o = 0; o < octaves; ++o)
+				{
+					noise3DBatch(bx, by, bz, octave);
+
+					for (std::size_t k = 0; k < BatchSize; ++k)
+					{
+						sum[k] += octave[k] * amp;
+						bx[k] *= 2;
+						by[k] *= 2;
+						bz[k] *= 2;
+					}
+
+					amp /= 2;
+				}
+
+				std::copy(sum, sum + n, result + i);
+			}
+		}
+
+		void accumulatedOctaveNoise3D_0_1(const value_type* x, const value_type* y, const value_type* z, std::int32_t octaves, value_type* result, std::size_t count) const noexcept
+		{
+			accumulatedOctaveNoise3D(x, y, z, octaves, result, count);
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				result[i] = std::clamp<value_type>(result[i]
+					* value_type(0.5) + value_type(0.5), 0, 1);
+			}
+		}
+
 		///////////////////////////////////////
 		//
 		//	Serialization
@@ -0,0 +1,226 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ContourSimplifier.hpp"
+#include "Generators.hpp"
+#include "SoftwareRasterizer.hpp"
+
+//Renders the animations from the window to numbered image files, for machines with no display or GPU.
+
+static void printUsage()
+{
+    std::cerr << "Usage: MarchingSquaresRender <output pattern, e.g. frames/frame%05d.png> [options]\n"
+                 "  --generator g      perlin or metaballs (default perlin)\n"
+                 "  --frames n         frames to render (default 100)\n"
+                 "  --format f         ppm or png (default png)\n"
+                 "  --points n         points across each axis (default 200)\n"
+                 "  --pixels n         pixels per point (default 4)\n"
+                 "  --levels a,b,c     iso levels to contour (default 0.3,0.4,0.5)\n"
+                 "  --view-scale s     image size relative to points * pixels, below 1 the contours are simplified to match (default 1)\n"
+                 "  --seed n           generator seed (default 1234)\n"
+                 "  --threads n        worker threads, 0 for single threaded (default: all cores)\n";
+}
+
+static std::vector<double> parseLevels(const std::string &text)
+{
+    std::vector<double> levels;
+    std::stringstream stream(text);
+    std::string level;
+    while(std::getline(stream, level, ','))
+        levels.push_back(std::stod(level));
+    return levels;
+}
+
+//pattern takes one printf style integer conversion, %d or a zero padded %05d, and %% for a literal %. The frame number is put in here instead of handing
+//the pattern to snprintf, so nothing the user types is ever used as a format string.
+static std::string getFramePath(const std::string &pattern, const size_t frameIndex)
+{
+    std::string path;
+    size_t conversionCount = 0;
+    for(size_t i = 0; i < pattern.size(); i++)
+    {
+        if(pattern[i] != '%')
+        {
+            path += pattern[i];
+            continue;
+        }
+        if(i + 1 < pattern.size() && pattern[i+1] == '%')
+        {
+            path += '%';
+            i++;
+            continue;
+        }
+
+        size_t end = i + 1;
+        while(end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9')
+            end++;
+        if(end >= pattern.size() || pattern[end] != 'd' || end - i > 4) //Widths up to 99
+            throw std::runtime_error("Output pattern " + pattern + " can only contain %d, %0Nd or %%");
+        const size_t width = (end > i + 1) ? std::stoul(pattern.substr(i + 1, end - i - 1)) : 0;
+        const std::string number = std::to_string(frameIndex);
+        path += std::string(width > number.size() ? width - number.size() : 0, '0') + number;
+        conversionCount++;
+        i = end;
+    }
+    if(conversionCount != 1)
+        throw std::runtime_error("Output pattern " + pattern + " needs exactly one frame number, e.g. frame%05d.png");
+    return path;
+}
+
+//Two of these take turns, one is written out while the next frame is contoured and rasterized.
+struct PendingImage
+{
+    std::vector<RasterPixel> pixels;
+    std::future<void> written;
+};
+
+//Returns the total number of vertices rasterized
+template<typename GeneratorType>
+static size_t renderFrames(GeneratorType &generator, const std::string &pattern, const bool png, const size_t frameCount, const size_t points, const size_t pixelsPerPoint,
+                           const std::vector<double> &isoLevels, const double viewScale, ThreadPool *threadPool)
+{
+    constexpr double DepthIncrementAmountPerFrame = 0.0005; //Same as main
+
+    //The last point is at (points - 1) * pixelsPerPoint, the same as the window, then the image is scaled by viewScale
+    const auto size = static_cast<size_t>(std::ceil(static_cast<double>(points * pixelsPerPoint) * viewScale));
+    SoftwareRasterOutput output(size, size, threadPool);
+    output.setScale(static_cast<float>(viewScale));
+    //Zoomed out the frames go through the simplifier, which only passes on as much detail as the smaller image can show
+    SnappedTriangleOutput simplifiedOutput(output);
+    const bool simplify = viewScale < 1.0;
+    //Float points like main, Perlin noise doesn't need double precision
+    MarchingSquares<std::dynamic_extent, std::dynamic_extent, std::dynamic_extent, std::dynamic_extent, float> squares(generator, simplify ? static_cast<ISquaresOutput &>(simplifiedOutput) : output,
+                                                                                                                     points, points, pixelsPerPoint, pixelsPerPoint);
+    squares.setThreadPool(threadPool);
+
+    std::vector<PendingImage> images(2);
+    //The write tasks use images, so it can't go away while one is still running. Declared after images so it runs first, even when a write error unwinds.
+    struct WaitForWrites
+    {
+        std::vector<PendingImage> &images;
+        ~WaitForWrites()
+        {
+            for(auto &image : images)
+                if(image.written.valid())
+                    image.written.wait();
+        }
+    } waitForWrites{images};
+
+    size_t vertexCount = 0;
+
+    for(size_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        squares.recalculate();
+        const size_t frameVertexCount = squares.render(isoLevels);
+        vertexCount += simplify ? simplifiedOutput.present(viewScale) : frameVertexCount;
+        output.rasterize();
+
+        auto &image = images[frameIndex % images.size()];
+        if(image.written.valid())
+            image.written.get(); //Rethrows write errors
+        image.pixels.assign(output.getPixels().begin(), output.getPixels().end());
+
+        auto write = [&image, path = getFramePath(pattern, frameIndex), png, size]()
+        {
+            if(png)
+                RasterImage::writePng(path, image.pixels, size, size);
+            else
+                RasterImage::writePpm(path, image.pixels, size, size);
+        };
+        if(threadPool)
+            image.written = threadPool->submit(write);
+        else
+            write();
+
+        generator.step(DepthIncrementAmountPerFrame);
+    }
+    for(auto &image : images)
+        if(image.written.valid())
+            image.written.get();
+    return vertexCount;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2 || (argc % 2) != 0)
+    {
+        printUsage();
+        return 1;
+    }
+
+    try
+    {
+        const std::string pattern = argv[1];
+        std::string generatorName = "perlin";
+        std::string formatName = "png";
+        size_t frameCount = 100;
+        size_t points = 200;
+        size_t pixelsPerPoint = 4;
+        double viewScale = 1.0;
+        std::vector<double> isoLevels{0.3, 0.4, 0.5};
+        size_t seed = 1234;
+        size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for(int i = 2; i + 1 < argc; i += 2)
+        {
+            const std::string option = argv[i];
+            if(option == "--generator") generatorName = argv[i+1];
+            else if(option == "--frames") frameCount = std::stoull(argv[i+1]);
+            else if(option == "--format") formatName = argv[i+1];
+            else if(option == "--points") points = std::stoull(argv[i+1]);
+            else if(option == "--pixels") pixelsPerPoint = std::stoull(argv[i+1]);
+            else if(option == "--levels") isoLevels = parseLevels(argv[i+1]);
+            else if(option == "--view-scale") viewScale = std::stod(argv[i+1]);
+            else if(option == "--seed") seed = std::stoull(argv[i+1]);
+            else if(option == "--threads") threadCount = std::stoull(argv[i+1]);
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        if((formatName != "png" && formatName != "ppm") || (generatorName != "perlin" && generatorName != "metaballs") || points < 2 || pixelsPerPoint == 0 ||
+           !(viewScale > 0.0 && viewScale <= 16.0))
+        {
+            printUsage();
+            return 1;
+        }
+
+        getFramePath(pattern, 0); //Reject a bad pattern before rendering anything
+
+        std::unique_ptr<ThreadPool> threadPool;
+        if(threadCount > 0)
+            threadPool = std::make_unique<ThreadPool>(threadCount);
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const bool png = formatName == "png";
+        size_t vertexCount = 0;
+        if(generatorName == "perlin")
+        {
+            PerlinHeightmapGenerator generator(points, points, seed);
+            vertexCount = renderFrames(generator, pattern, png, frameCount, points, pixelsPerPoint, isoLevels, viewScale, threadPool.get());
+        }
+        else
+        {
+            MetaBallsGenerator generator(points, points, seed);
+            vertexCount = renderFrames(generator, pattern, png, frameCount, points, pixelsPerPoint, isoLevels, viewScale, threadPool.get());
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        std::cout << "Rendered " << frameCount << " frames in " << seconds << "s, " << static_cast<double>(frameCount) / seconds << " fps, "
+                  << static_cast<double>(vertexCount) / static_cast<double>(std::max<size_t>(frameCount, 1)) << " vertices per frame\n";
+    }
+    catch(const std::exception &exception)
+    {
+        std::cerr << exception.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "MarchingSquares.hpp"
+#include "ThreadPool.hpp"
+
+struct RasterPixel
+{
+    uint8_t r, g, b, a;
+};
+
+//Same colours as the SFML window, so offline renders look like the interactive ones.
+inline RasterPixel getDefaultIsoLevelColor(double isoLevel)
+{
+    RasterPixel color{255, 255, 255, 255};
+    if(isoLevel < 0.5) color = {0, 255, 0, 255};
+    if(isoLevel < 0.4) color = {255, 0, 0, 255};
+    return color;
+}
+
+//Draws the triangles from render() into a framebuffer in memory, for rendering frames on machines without a display or GPU.
+//rasterize() bins the triangles into tiles and fills the tiles in parallel on the thread pool. Vertices are snapped to 1/256th of a pixel and covered
+//pixels are found with exact integer edge functions and a top-left rule, so triangles that share an edge never leave gaps or both draw a pixel.
+//Triangles are drawn in the order they were written, so higher iso levels cover lower ones like they do in the window.
+class SoftwareRasterOutput : public ISquaresOutput
+{
+    constexpr static size_t TileSize = 64;                  //Pixels per tile side
+    constexpr static size_t TrianglesPerBinJob = 16384;     //Triangles binned by one task
+    constexpr static int64_t SubpixelSteps = 256;           //Vertices are snapped to 1/SubpixelSteps of a pixel, toPixel() relies on it being 2^8
+
+    //Edge function of one triangle edge along a row of pixel centres, k * x + c >= 0 for pixels inside the edge. c grows by stepC every row.
+    struct Edge
+    {
+        int64_t k, c, stepC;
+    };
+
+    struct Triangle
+    {
+        std::array<Edge, 3> edges;
+        int32_t minX, minY, maxX, maxY; //Pixels that could be covered, inclusive and clamped to the framebuffer. Empty if minX > maxX.
+        RasterPixel color;
+    };
+
+    size_t mWidth, mHeight;
+    size_t mTileCountX, mTileCountY;
+    ThreadPool *mThreadPool = nullptr;
+    std::function<RasterPixel(double)> mIsoLevelColor = getDefaultIsoLevelColor;
+    RasterPixel mBackground{0, 0, 0, 255};
+    float mScale = 1.0f;
+
+    std::vector<SquaresVertex> mVertices;
+    std::vector<RasterPixel> mVertexColors;     //The first vertex of a triangle decides its colour
+    std::vector<RasterPixel> mIsoLevelColors;   //Colour of each iso level, so bulk writes don't need to pick a colour per vertex
+
+    std::vector<Triangle> mTriangles;
+    std::vector<std::vector<std::vector<uint32_t>>> mBins; //Triangles of each bin job that touch each tile, [job][tile], in drawing order
+    std::vector<RasterPixel> mPixels;
+
+    template<typename Function>
+    void forEachIndex(const size_t count, Function &&function)
+    {
+        if(mThreadPool)
+            mThreadPool->parallelFor(count, function);
+        else
+            for(size_t i = 0; i < count; i++)
+                function(i);
+    }
+
+    //Rounds towards negative infinity, unlike /
+    static int64_t floorDivide(const int64_t numerator, const int64_t denominator)
+    {
+        const int64_t quotient = numerator / denominator;
+        return (numerator % denominator != 0 && ((numerator < 0) != (denominator < 0))) ? quotient - 1 : quotient;
+    }
+
+    int64_t snap(const float value) const
+    {
+        return static_cast<int64_t>(std::lrint(value * mScale * static_cast<float>(SubpixelSteps))); //Exact, the steps are a power of two
+    }
+
+    void setupTriangle(const size_t triangleIndex)
+    {
+        auto &triangle = mTriangles[triangleIndex];
+        const SquaresVertex *vertices = mVertices.data() + (triangleIndex * 3);
+        std::array<int64_t, 3> x{snap(vertices[0].x), snap(vertices[1].x), snap(vertices[2].x)};
+        std::array<int64_t, 3> y{snap(vertices[0].y), snap(vertices[1].y), snap(vertices[2].y)};
+        triangle.color = mVertexColors[triangleIndex * 3];
+        triangle.minX = 0;
+        triangle.maxX = -1;
+
+        const int64_t area = ((x[1] - x[0]) * (y[2] - y[0])) - ((y[1] - y[0]) * (x[2] - x[0]));
+        if(area == 0)
+            return; //Covers no pixel centres
+        if(area < 0)
+        {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        for(size_t i = 0; i < 3; i++)
+        {
+            const size_t next = (i + 1) % 3;
+            const int64_t dx = x[next] - x[i], dy = y[next] - y[i];
+            const int64_t bias = (dy > 0 || (dy == 0 && dx < 0)) ? 0 : -1; //Of the two triangles on an edge only this side owns pixel centres exactly on it
+            //Pixel centre (x + 0.5, y + 0.5) in subpixels is (SubpixelSteps * x + SubpixelSteps / 2, ...)
+            constexpr int64_t HalfPixel = SubpixelSteps / 2;
+            triangle.edges[i].k = -dy * SubpixelSteps;
+            triangle.edges[i].c = (-dy * HalfPixel) + (dx * (HalfPixel - y[i])) + (dy * x[i]) + bias;
+            triangle.edges[i].stepC = dx * SubpixelSteps;
+        }
+
+        const auto toPixel = [](const int64_t subpixels) { return subpixels >> 8; }; //floor(subpixels / SubpixelSteps)
+        triangle.minX = static_cast<int32_t>(std::max<int64_t>(toPixel(*std::min_element(x.begin(), x.end())), 0));
+        triangle.minY = static_cast<int32_t>(std::max<int64_t>(toPixel(*std::min_element(y.begin(), y.end())), 0));
+        triangle.maxX = static_cast<int32_t>(std::min<int64_t>(toPixel(*std::max_element(x.begin(), x.end())), static_cast<int64_t>(mWidth) - 1));
+        triangle.maxY = static_cast<int32_t>(std::min<int64_t>(toPixel(*std::max_element(y.begin(), y.end())), static_cast<int64_t>(mHeight) - 1));
+        if(triangle.minY > triangle.maxY)
+            triangle.maxX = triangle.minX - 1;
+    }
+
+    void binTriangles(const size_t jobIndex)
+    {
+        auto &bins = mBins[jobIndex];
+        for(auto &bin : bins)
+            bin.clear(); //Keeps the capacity, after the first few frames binning doesn't allocate
+
+        const size_t triangleCount = mVertices.size() / 3;
+        const size_t end = std::min(triangleCount, (jobIndex + 1) * TrianglesPerBinJob);
+        for(size_t triangleIndex = jobIndex * TrianglesPerBinJob; triangleIndex < end; triangleIndex++)
+        {
+            setupTriangle(triangleIndex);
+            const auto &triangle = mTriangles[triangleIndex];
+            if(triangle.minX > triangle.maxX)
+                continue;
+
+            for(size_t tileY = triangle.minY / TileSize; tileY <= triangle.maxY / TileSize; tileY++)
+                for(size_t tileX = triangle.minX / TileSize; tileX <= triangle.maxX / TileSize; tileX++)
+                    bins[(tileY * mTileCountX) + tileX].push_back(static_cast<uint32_t>(triangleIndex));
+        }
+    }
+
+    //Small triangles, which is most of them at a few pixels per point, step the edge functions across every pixel of their bounds.
+    //Bigger ones solve the edge functions for x once per row and fill the span in between, which costs three divisions but no per pixel tests.
+    void drawTriangle(const Triangle &triangle, const int64_t tileMinX, const int64_t tileMinY, const int64_t tileMaxX, const int64_t tileMaxY)
+    {
+        constexpr int64_t MaxSteppedWidth = 16;
+        const int64_t minY = std::max<int64_t>(triangle.minY, tileMinY), maxY = std::min<int64_t>(triangle.maxY, tileMaxY);
+        const int64_t boundMinX = std::max<int64_t>(triangle.minX, tileMinX), boundMaxX = std::min<int64_t>(triangle.maxX, tileMaxX);
+        const auto &edges = triangle.edges;
+        for(int64_t y = minY; y <= maxY; y++)
+        {
+            RasterPixel *row = mPixels.data() + (y * static_cast<int64_t>(mWidth));
+            if(boundMaxX - boundMinX < MaxSteppedWidth)
+            {
+                int64_t w0 = edges[0].c + (edges[0].stepC * y) + (edges[0].k * boundMinX);
+                int64_t w1 = edges[1].c + (edges[1].stepC * y) + (edges[1].k * boundMinX);
+                int64_t w2 = edges[2].c + (edges[2].stepC * y) + (edges[2].k * boundMinX);
+                for(int64_t x = boundMinX; x <= boundMaxX; x++, w0 += edges[0].k, w1 += edges[1].k, w2 += edges[2].k)
+                    if((w0 | w1 | w2) >= 0) //All three signs clear
+                        row[x] = triangle.color;
+                continue;
+            }
+
+            int64_t spanMinX = boundMinX, spanMaxX = boundMaxX;
+            for(const auto &edge : edges)
+            {
+                const int64_t c = edge.c + (edge.stepC * y);
+                if(edge.k > 0)
+                    spanMinX = std::max(spanMinX, -floorDivide(c, edge.k)); //ceil(-c / k)
+                else if(edge.k < 0)
+                    spanMaxX = std::min(spanMaxX, floorDivide(c, -edge.k));
+                else if(c < 0)
+                    spanMaxX = spanMinX - 1; //Horizontal edge with the row outside it
+            }
+            if(spanMinX <= spanMaxX)
+                std::fill_n(row + spanMinX, spanMaxX - spanMinX + 1, triangle.color);
+        }
+    }
+
+    void drawTile(const size_t tileIndex)
+    {
+        const int64_t tileMinX = static_cast<int64_t>((tileIndex % mTileCountX) * TileSize);
+        const int64_t tileMinY = static_cast<int64_t>((tileIndex / mTileCountX) * TileSize);
+        const int64_t tileMaxX = std::min<int64_t>(tileMinX + TileSize, static_cast<int64_t>(mWidth)) - 1;
+        const int64_t tileMaxY = std::min<int64_t>(tileMinY + TileSize, static_cast<int64_t>(mHeight)) - 1;
+
+        for(int64_t y = tileMinY; y <= tileMaxY; y++)
+            std::fill_n(mPixels.data() + (y * static_cast<int64_t>(mWidth)) + tileMinX, tileMaxX - tileMinX + 1, mBackground);
+        for(const auto &bins : mBins) //Bin jobs are in triangle order, so this draws the triangles in the order they were written
+            for(const auto triangleIndex : bins[tileIndex])
+                drawTriangle(mTriangles[triangleIndex], tileMinX, tileMinY, tileMaxX, tileMaxY);
+    }
+
+public:
+    //width and height in pixels, the same units as the vertices (points * pixels per point). Without a thread pool rasterize() runs on the calling thread.
+    SoftwareRasterOutput(size_t width, size_t height, ThreadPool *threadPool = nullptr) : mWidth(width), mHeight(height),
+        mTileCountX((width + TileSize - 1) / TileSize), mTileCountY((height + TileSize - 1) / TileSize), mThreadPool(threadPool), mPixels(width * height)
+    {
+        if(width == 0 || height == 0)
+            throw std::runtime_error("The framebuffer needs at least one pixel");
+    }
+
+    void setIsoLevelColors(std::function<RasterPixel(double)> isoLevelColor)
+    {
+        mIsoLevelColor = std::move(isoLevelColor);
+    }
+
+    void setBackground(RasterPixel background)
+    {
+        mBackground = background;
+    }
+
+    //Vertices are multiplied by scale when they're drawn, to draw frames smaller or bigger than they were rendered
+    void setScale(float scale)
+    {
+        mScale = scale;
+    }
+
+    void resetVertices(size_t vertexCount) override //New vertices get the first iso level's colour until writeVertices() gives them their own
+    {
+        mVertices.resize(vertexCount);
+        mVertexColors.assign(vertexCount, mIsoLevelColors.empty() ? RasterPixel{255, 255, 255, 255} : mIsoLevelColors.front());
+    }
+
+    void addVertex(double isoLevel, double x, double y) override
+    {
+        mVertices.push_back({static_cast<float>(x), static_cast<float>(y)});
+        mVertexColors.push_back(mIsoLevelColor(isoLevel));
+    }
+
+    void setVertex(size_t vertexIndex, double x, double y) override //Only moves the vertex, it keeps the colour it was given
+    {
+        mVertices[vertexIndex] = {static_cast<float>(x), static_cast<float>(y)};
+    }
+
+    void setIsoLevels(const std::vector<double> &isoLevels) override
+    {
+        mIsoLevelColors.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mIsoLevelColors.begin(), [this](const double isoLevel) { return mIsoLevelColor(isoLevel); });
+    }
+
+    void writeVertices(size_t firstVertex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override //Fast path used by render()
+    {
+        std::copy(vertices.begin(), vertices.end(), mVertices.begin() + static_cast<std::ptrdiff_t>(firstVertex));
+        std::fill_n(mVertexColors.begin() + static_cast<std::ptrdiff_t>(firstVertex), vertices.size(), mIsoLevelColors[isoLevelIndex]);
+    }
+
+    //Draw the vertices written since the last resetVertices() into the framebuffer, replacing what was there.
+    void rasterize()
+    {
+        MS_SCOPED_TIMER(Draw);
+        const size_t triangleCount = mVertices.size() / 3;
+        const size_t binJobCount = (triangleCount + TrianglesPerBinJob - 1) / TrianglesPerBinJob;
+        mTriangles.resize(triangleCount);
+        if(mBins.size() < binJobCount)
+            mBins.resize(binJobCount, std::vector<std::vector<uint32_t>>(mTileCountX * mTileCountY));
+        else
+            mBins.resize(binJobCount); //Drops the jobs this frame doesn't need, so drawTile() doesn't see stale bins
+
+        forEachIndex(binJobCount, [this](const size_t jobIndex) { binTriangles(jobIndex); });
+        forEachIndex(mTileCountX * mTileCountY, [this](const size_t tileIndex) { drawTile(tileIndex); });
+    }
+
+    size_t getWidth() const
+    {
+        return mWidth;
+    }
+
+    size_t getHeight() const
+    {
+        return mHeight;
+    }
+
+    //Rows top to bottom, width pixels each
+    std::span<const RasterPixel> getPixels() const
+    {
+        return mPixels;
+    }
+};
+
+//Writing framebuffers to image files. Both formats are written without any libraries, PNGs use uncompressed deflate blocks so they're about the size of a PPM.
+namespace RasterImage
+{
+    namespace Detail
+    {
+        inline uint32_t updateCrc(uint32_t crc, std::span<const uint8_t> data)
+        {
+            static const auto table = []()
+            {
+                std::array<uint32_t, 256> crcTable{};
+                for(uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t value = i;
+                    for(int bit = 0; bit < 8; bit++)
+                        value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                    crcTable[i] = value;
+                }
+                return crcTable;
+            }();
+            crc = ~crc;
+            for(const auto byte : data)
+                crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        inline void appendBigEndian(std::vector<uint8_t> &bytes, const uint32_t value)
+        {
+            for(int shift = 24; shift >= 0; shift -= 8)
+                bytes.push_back(static_cast<uint8_t>(value >> shift));
+        }
+
+        inline void appendChunk(std::vector<uint8_t> &bytes, const char (&type)[5], std::span<const uint8_t> data)
+        {
+            appendBigEndian(bytes, static_cast<uint32_t>(data.size()));
+            const size_t typeStart = bytes.size();
+            bytes.insert(bytes.end(), type, type + 4);
+            bytes.insert(bytes.end(), data.begin(), data.end());
+            appendBigEndian(bytes, updateCrc(0, std::span(bytes).subspan(typeStart)));
+        }
+
+        inline void writeFile(const std::string &path, std::span<const uint8_t> bytes)
+        {
+            std::FILE *file = std::fopen(path.c_str(), "wb");
+            if(!file)
+                throw std::runtime_error("Unable to open " + path);
+            const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+            if(std::fclose(file) != 0 || !written)
+                throw std::runtime_error("Unable to write " + path);
+        }
+    }
+
+    //Binary PPM (P6), RGB
+    inline void writePpm(const std::string &path, std::span<const RasterPixel> pixels, const size_t width, const size_t height)
+    {
+        const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        std::vector<uint8_t> bytes(header.size() + (width * height * 3));
+        std::copy(header.begin(), header.end(), bytes.begin());
+        uint8_t *rgb = bytes.data() + header.size();
+        for(const auto &pixel : pixels.first(width * height))
+        {
+            *rgb++ = pixel.r;
+            *rgb++ = pixel.g;
+            *rgb++ = pixel.b;
+        }
+        Detail::writeFile(path, bytes);
+    }
+
+    //8 bit RGB PNG
+    inline void writePng(const std::string &path, std::span<const RasterPixel> pixels, const size_t width, const size_t height)
+    {
+        //Every row starts with filter type 0 (none)
+        const size_t rowSize = 1 + (width * 3);
+        std::vector<uint8_t> rows(rowSize * height);
+        for(size_t y = 0; y < height; y++)
+        {
+            uint8_t *rgb = rows.data() + (y * rowSize);
+            *rgb++ = 0;
+            for(const auto &pixel : pixels.subspan(y * width, width))
+            {
+                *rgb++ = pixel.r;
+                *rgb++ = pixel.g;
+                *rgb++ = pixel.b;
+            }
+        }
+
+        //zlib stream of stored deflate blocks, each at most 65535 bytes
+        constexpr size_t MaxBlockSize = 65535;
+        std::vector<uint8_t> zlib{0x78, 0x01};
+        zlib.reserve(rows.size() + ((rows.size() / MaxBlockSize) + 1) * 5 + 6);
+        uint32_t adlerA = 1, adlerB = 0;
+        for(size_t start = 0; start < rows.size(); start += MaxBlockSize)
+        {
+            const size_t blockSize = std::min(MaxBlockSize, rows.size() - start);
+            const bool lastBlock = start + blockSize >= rows.size();
+            zlib.insert(zlib.end(), {static_cast<uint8_t>(lastBlock ? 1 : 0), static_cast<uint8_t>(blockSize), static_cast<uint8_t>(blockSize >> 8),
+                                     static_cast<uint8_t>(~blockSize), static_cast<uint8_t>(~blockSize >> 8)});
+            zlib.insert(zlib.end(), rows.begin() + static_cast<std::ptrdiff_t>(start), rows.begin() + static_cast<std::ptrdiff_t>(start + blockSize));
+            //5552 bytes is the most that can be summed before adlerB could overflow, so the remainders are only taken that often
+            for(size_t runStart = start; runStart < start + blockSize; runStart += 5552)
+            {
+                for(size_t i = runStart; i < std::min(runStart + 5552, start + blockSize); i++)
+                {
+                    adlerA += rows[i];
+                    adlerB += adlerA;
+                }
+                adlerA %= 65521;
+                adlerB %= 65521;
+            }
+            if(lastBlock)
+                break;
+        }
+        Detail::appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+        std::vector<uint8_t> header;
+        Detail::appendBigEndian(header, static_cast<uint32_t>(width));
+        Detail::appendBigEndian(header, static_cast<uint32_t>(height));
+        header.insert(header.end(), {8, 2, 0, 0, 0}); //8 bit depth, RGB, deflate, no filtering extensions, not interlaced
+
+        std::vector<uint8_t> bytes{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        bytes.reserve(zlib.size() + 64);
+        Detail::appendChunk(bytes, "IHDR", header);
+        Detail::appendChunk(bytes, "IDAT", zlib);
+        Detail::appendChunk(bytes, "IEND", {});
+        Detail::writeFile(path, bytes);
+    }
+}
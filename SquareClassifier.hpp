@@ -0,0 +1,241 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MARCHING_SQUARES_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define MARCHING_SQUARES_TARGET_AVX2
+#else
+#define MARCHING_SQUARES_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//Row-wise square classification.
+//Instead of loading and comparing all four corners of every square, a whole row of points is compared against the iso level once,
+//then two neighbouring rows of results are combined into the 4-bit square types for a full row of squares.
+//The widest instruction set the CPU supports is picked at runtime (AVX2, then SSE2, then plain scalar code).
+//Points can be double, float, uint16_t or uint8_t, the comparison is done on the stored type so narrow grids need less bandwidth.
+namespace SquareClassifier
+{
+    //Writes 1 to aboveIso[i] if points[i] > threshold, otherwise 0.
+    template<typename PointType>
+    using ClassifyPointsFunction = void (*)(const PointType *points, size_t count, PointType threshold, uint8_t *aboveIso);
+    //Combines two classified rows (each squareCount + 1 points long) into squareCount square types.
+    //Same bit layout as MarchingSquares::getSquareType: TopLeft 0x1, TopRight 0x2, BottomRight 0x4, BottomLeft 0x8.
+    using CombineRowsFunction = void (*)(const uint8_t *topRow, const uint8_t *bottomRow, size_t squareCount, uint8_t *squareTypes);
+
+    template<typename PointType>
+    struct Implementation
+    {
+        const char *name;
+        ClassifyPointsFunction<PointType> classifyPoints;
+        CombineRowsFunction combineRows;
+    };
+
+    template<typename PointType>
+    inline void classifyPointsScalar(const PointType *points, const size_t count, const PointType threshold, uint8_t *aboveIso)
+    {
+        for(size_t i = 0; i < count; i++)
+            aboveIso[i] = points[i] > threshold ? 1 : 0;
+    }
+
+    inline void combineRowsScalar(const uint8_t *topRow, const uint8_t *bottomRow, const size_t squareCount, uint8_t *squareTypes)
+    {
+        for(size_t x = 0; x < squareCount; x++)
+            squareTypes[x] = static_cast<uint8_t>(topRow[x] | (topRow[x+1] << 1u) | (bottomRow[x+1] << 2u) | (bottomRow[x] << 3u));
+    }
+
+#ifdef MARCHING_SQUARES_X86_64
+    //movemask results expanded back to one byte per point (little endian).
+    constexpr uint16_t ExpandMask2[4] = {0x0000, 0x0001, 0x0100, 0x0101};
+    constexpr uint32_t ExpandMask4[16] = {0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+                                          0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101};
+
+    inline void classifyPointsSSE2(const double *points, const size_t count, const double threshold, uint8_t *aboveIso)
+    {
+        const __m128d iso = _mm_set1_pd(threshold);
+        size_t i = 0;
+        for(; i + 2 <= count; i += 2)
+        {
+            const uint16_t expanded = ExpandMask2[_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(points + i), iso))];
+            aboveIso[i]   = static_cast<uint8_t>(expanded);
+            aboveIso[i+1] = static_cast<uint8_t>(expanded >> 8u);
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    inline void classifyPointsSSE2(const float *points, const size_t count, const float threshold, uint8_t *aboveIso)
+    {
+        const __m128 iso = _mm_set1_ps(threshold);
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            const uint32_t expanded = ExpandMask4[_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(points + i), iso))];
+            std::memcpy(aboveIso + i, &expanded, sizeof(expanded));
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    //SSE2 only has signed integer compares, flipping the top bit maps unsigned order onto signed order.
+    inline void classifyPointsSSE2(const uint16_t *points, const size_t count, const uint16_t threshold, uint8_t *aboveIso)
+    {
+        const __m128i signBit = _mm_set1_epi16(static_cast<short>(0x8000));
+        const __m128i iso = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(threshold)), signBit);
+        const __m128i one = _mm_set1_epi8(1);
+        size_t i = 0;
+        for(; i + 16 <= count; i += 16)
+        {
+            const __m128i low  = _mm_cmpgt_epi16(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(points + i)), signBit), iso);
+            const __m128i high = _mm_cmpgt_epi16(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(points + i + 8)), signBit), iso);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(aboveIso + i), _mm_and_si128(_mm_packs_epi16(low, high), one)); //0/-1 words pack to 0/-1 bytes
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    inline void classifyPointsSSE2(const uint8_t *points, const size_t count, const uint8_t threshold, uint8_t *aboveIso)
+    {
+        const __m128i signBit = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i iso = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(threshold)), signBit);
+        const __m128i one = _mm_set1_epi8(1);
+        size_t i = 0;
+        for(; i + 16 <= count; i += 16)
+        {
+            const __m128i above = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(points + i)), signBit), iso);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(aboveIso + i), _mm_and_si128(above, one));
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    //Every byte is 0 or 1, so shifting 16-bit lanes by up to 3 never carries into the neighbouring byte.
+    inline void combineRowsSSE2(const uint8_t *topRow, const uint8_t *bottomRow, const size_t squareCount, uint8_t *squareTypes)
+    {
+        size_t x = 0;
+        for(; x + 16 <= squareCount; x += 16)
+        {
+            const __m128i topLeft     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(topRow + x));
+            const __m128i topRight    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(topRow + x + 1));
+            const __m128i bottomRight = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottomRow + x + 1));
+            const __m128i bottomLeft  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottomRow + x));
+
+            const __m128i types = _mm_or_si128(_mm_or_si128(topLeft, _mm_slli_epi16(topRight, 1)),
+                                               _mm_or_si128(_mm_slli_epi16(bottomRight, 2), _mm_slli_epi16(bottomLeft, 3)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(squareTypes + x), types);
+        }
+        combineRowsScalar(topRow + x, bottomRow + x, squareCount - x, squareTypes + x);
+    }
+
+    MARCHING_SQUARES_TARGET_AVX2 inline void classifyPointsAVX2(const double *points, const size_t count, const double threshold, uint8_t *aboveIso)
+    {
+        const __m256d iso = _mm256_set1_pd(threshold);
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            const int low  = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(points + i), iso, _CMP_GT_OQ));
+            const int high = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(points + i + 4), iso, _CMP_GT_OQ));
+            const uint64_t expanded = ExpandMask4[low] | (static_cast<uint64_t>(ExpandMask4[high]) << 32u);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(aboveIso + i), _mm_cvtsi64_si128(static_cast<long long>(expanded)));
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    MARCHING_SQUARES_TARGET_AVX2 inline void classifyPointsAVX2(const float *points, const size_t count, const float threshold, uint8_t *aboveIso)
+    {
+        const __m256 iso = _mm256_set1_ps(threshold);
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            const int above = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(points + i), iso, _CMP_GT_OQ));
+            const uint64_t expanded = ExpandMask4[above & 0xF] | (static_cast<uint64_t>(ExpandMask4[above >> 4]) << 32u);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(aboveIso + i), _mm_cvtsi64_si128(static_cast<long long>(expanded)));
+        }
+        classifyPointsScalar(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    MARCHING_SQUARES_TARGET_AVX2 inline void classifyPointsAVX2(const uint16_t *points, const size_t count, const uint16_t threshold, uint8_t *aboveIso)
+    {
+        const __m256i signBit = _mm256_set1_epi16(static_cast<short>(0x8000));
+        const __m256i iso = _mm256_xor_si256(_mm256_set1_epi16(static_cast<short>(threshold)), signBit);
+        const __m256i one = _mm256_set1_epi8(1);
+        size_t i = 0;
+        for(; i + 32 <= count; i += 32)
+        {
+            const __m256i low  = _mm256_cmpgt_epi16(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + i)), signBit), iso);
+            const __m256i high = _mm256_cmpgt_epi16(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + i + 16)), signBit), iso);
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8); //packs works per 128-bit lane, put the lanes back in order
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(aboveIso + i), _mm256_and_si256(packed, one));
+        }
+        classifyPointsSSE2(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    MARCHING_SQUARES_TARGET_AVX2 inline void classifyPointsAVX2(const uint8_t *points, const size_t count, const uint8_t threshold, uint8_t *aboveIso)
+    {
+        const __m256i signBit = _mm256_set1_epi8(static_cast<char>(0x80));
+        const __m256i iso = _mm256_xor_si256(_mm256_set1_epi8(static_cast<char>(threshold)), signBit);
+        const __m256i one = _mm256_set1_epi8(1);
+        size_t i = 0;
+        for(; i + 32 <= count; i += 32)
+        {
+            const __m256i above = _mm256_cmpgt_epi8(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + i)), signBit), iso);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(aboveIso + i), _mm256_and_si256(above, one));
+        }
+        classifyPointsSSE2(points + i, count - i, threshold, aboveIso + i);
+    }
+
+    MARCHING_SQUARES_TARGET_AVX2 inline void combineRowsAVX2(const uint8_t *topRow, const uint8_t *bottomRow, const size_t squareCount, uint8_t *squareTypes)
+    {
+        size_t x = 0;
+        for(; x + 32 <= squareCount; x += 32)
+        {
+            const __m256i topLeft     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(topRow + x));
+            const __m256i topRight    = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(topRow + x + 1));
+            const __m256i bottomRight = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottomRow + x + 1));
+            const __m256i bottomLeft  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottomRow + x));
+
+            const __m256i types = _mm256_or_si256(_mm256_or_si256(topLeft, _mm256_slli_epi16(topRight, 1)),
+                                                  _mm256_or_si256(_mm256_slli_epi16(bottomRight, 2), _mm256_slli_epi16(bottomLeft, 3)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(squareTypes + x), types);
+        }
+        combineRowsSSE2(topRow + x, bottomRow + x, squareCount - x, squareTypes + x);
+    }
+
+    inline bool cpuSupportsAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6); //OSXSAVE set and the OS preserves the AVX registers.
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    template<typename PointType>
+    inline Implementation<PointType> selectImplementation()
+    {
+#ifdef MARCHING_SQUARES_X86_64
+        if(cpuSupportsAVX2())
+            return {"AVX2", classifyPointsAVX2, combineRowsAVX2};
+        return {"SSE2", classifyPointsSSE2, combineRowsSSE2}; //SSE2 is always available on x86-64
+#else
+        return {"Scalar", classifyPointsScalar<PointType>, combineRowsScalar};
+#endif
+    }
+
+    //The CPU is only queried once per point type, the first time a classifier is needed.
+    template<typename PointType = double>
+    inline const Implementation<PointType> &implementation()
+    {
+        static const Implementation<PointType> selected = selectImplementation<PointType>();
+        return selected;
+    }
+}
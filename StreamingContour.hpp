@@ -0,0 +1,152 @@
+#pragma once
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "MarchingSquares.hpp"
+
+//Out-of-core contouring of raw rasters that don't fit in memory.
+//The raster is memory mapped and marched in bands of rows. Each band also loads the first row of the next band (a one row halo)
+//so the squares between two bands are still covered, memory use depends on the band size and not the raster size.
+
+enum class RasterFormat
+{
+    Float32,
+    Float64,
+    Int16
+};
+
+//A headerless, row-major raster of native-endian samples mapped straight from disk.
+class MappedRaster
+{
+    MappedFile mFile;
+    size_t mWidth, mHeight;
+    RasterFormat mFormat;
+
+    //memcpy avoids unaligned reads from the mapping, compilers turn it into a plain load.
+    template<typename SampleType>
+    static void convertSamples(const uint8_t *samples, std::span<double> points)
+    {
+        for(size_t i = 0; i < points.size(); i++)
+        {
+            SampleType sample;
+            std::memcpy(&sample, samples + i * sizeof(SampleType), sizeof(SampleType));
+            points[i] = static_cast<double>(sample);
+        }
+    }
+
+public:
+    static size_t getSampleSize(const RasterFormat format)
+    {
+        switch(format)
+        {
+        case RasterFormat::Float32: return sizeof(float);
+        case RasterFormat::Float64: return sizeof(double);
+        case RasterFormat::Int16:   return sizeof(int16_t);
+        }
+        return 0;
+    }
+
+    MappedRaster(const std::string &path, size_t width, size_t height, RasterFormat format) : mFile(path), mWidth(width), mHeight(height), mFormat(format)
+    {
+        if(width < 2 || height < 2)
+            throw std::runtime_error("A raster needs at least 2x2 samples");
+        if(mFile.size() < getRowSize() * height)
+            throw std::runtime_error(path + " is smaller than " + std::to_string(width) + "x" + std::to_string(height) + " samples");
+    }
+
+    size_t getWidth() const { return mWidth; }
+    size_t getHeight() const { return mHeight; }
+    size_t getRowSize() const { return mWidth * getSampleSize(mFormat); }
+
+    //Convert points.size() samples starting at x/y to doubles.
+    void readRow(const size_t x, const size_t y, std::span<double> points) const
+    {
+        const uint8_t *samples = mFile.data() + (y * getRowSize()) + (x * getSampleSize(mFormat));
+        switch(mFormat)
+        {
+        case RasterFormat::Float32: convertSamples<float>(samples, points); break;
+        case RasterFormat::Float64: convertSamples<double>(samples, points); break;
+        case RasterFormat::Int16:   convertSamples<int16_t>(samples, points); break;
+        }
+    }
+
+    //Rows [beginRow, endRow) won't be read again.
+    void releaseRows(const size_t beginRow, const size_t endRow) const
+    {
+        mFile.release(beginRow * getRowSize(), (endRow - beginRow) * getRowSize());
+    }
+};
+
+//Feeds one band of the raster to MarchingSquares, row 0 of the grid is row firstRow of the raster.
+class RasterBandGenerator : public ISquaresGenerator
+{
+    const MappedRaster &mRaster;
+    size_t mFirstRow = 0;
+
+public:
+    explicit RasterBandGenerator(const MappedRaster &raster) : mRaster(raster) {}
+
+    void setFirstRow(size_t firstRow)
+    {
+        mFirstRow = firstRow;
+    }
+
+    double getPoint(size_t x, size_t y) override
+    {
+        double point = 0.0;
+        mRaster.readRow(x, mFirstRow + y, std::span(&point, 1));
+        return point;
+    }
+
+    void getRow(size_t x, size_t y, std::span<double> points) override
+    {
+        mRaster.readRow(x, mFirstRow + y, points);
+    }
+};
+
+//Marches a MappedRaster band by band into an output sink.
+class StreamingMarchingSquares
+{
+    const MappedRaster &mRaster;
+    RasterBandGenerator mGenerator;
+    size_t mBandRows;
+    MarchingSquares<> mSquares;
+    bool mFirstBandLoaded = true; //The constructor already loaded the first band's points
+
+public:
+    //bandRows is the number of rows of squares per band, pixelsPerPoint scales the output coordinates.
+    //The sink gets a resetVertices() call at the start of every band, followed by that band's vertices in raster coordinates.
+    StreamingMarchingSquares(const MappedRaster &raster, ISquaresOutput &sink, size_t bandRows, size_t pixelsPerPoint = 1) : mRaster(raster),
+                                                                                                                             mGenerator(raster),
+                                                                                                                             mBandRows(std::max<size_t>(bandRows, 1)),
+                                                                                                                             mSquares(mGenerator, sink, raster.getWidth(), std::min(mBandRows + 1, raster.getHeight()),
+                                                                                                                                      pixelsPerPoint, pixelsPerPoint)
+    {}
+
+    void setThreadPool(ThreadPool *threadPool)
+    {
+        mSquares.setThreadPool(threadPool);
+    }
+
+    //Contour the whole raster, returns the number of vertices written to the sink.
+    size_t run(const std::vector<double> &isoLevels)
+    {
+        size_t vertexCount = 0;
+        const size_t squareRows = mRaster.getHeight() - 1;
+        for(size_t firstRow = 0; firstRow < squareRows; firstRow += mBandRows)
+        {
+            const size_t bandRows = std::min(mBandRows, squareRows - firstRow);
+            mGenerator.setFirstRow(firstRow);
+            mSquares.setGridOffset(0, firstRow);
+            if(firstRow > 0 || !mFirstBandLoaded) //The constructor sized the grid for the first band, bandRows + 1 rows
+                mSquares.resize(mRaster.getWidth(), bandRows + 1); //+1 for the halo row. Also loads the band's points.
+            mFirstBandLoaded = false;
+
+            vertexCount += mSquares.render(isoLevels);
+            mRaster.releaseRows(firstRow, firstRow + bandRows); //The halo row is the first row of the next band, so keep it.
+        }
+        return vertexCount;
+    }
+};
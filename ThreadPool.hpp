@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Instrumentation.hpp"
+
+//Work-stealing thread pool.
+//Every worker has its own task queue. Workers take their newest task first (it's most likely to still be in cache) and when they run
+//out, steal the oldest task from another worker. Idle workers block on a condition variable instead of polling.
+class ThreadPool
+{
+    struct WorkerQueue
+    {
+        std::deque<std::function<void()>> tasks;
+        std::mutex sync;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+    std::vector<std::thread> mThreads;
+    std::atomic<size_t> mPendingTasks{0};   //Queued but not yet started, lets idle workers know whether it's worth looking.
+    std::atomic<size_t> mNextQueue{0};      //Round robin for tasks submitted from outside the pool.
+    std::mutex mSleepSync;
+    std::condition_variable mTasksAvailable;
+    bool mIsRunning = true;
+
+    //Which worker of which pool the current thread is, so tasks submitted from a worker go to its own queue.
+    inline static thread_local ThreadPool *tCurrentPool = nullptr;
+    inline static thread_local size_t tWorkerIndex = 0;
+
+    bool popTask(const size_t queueIndex, std::function<void()> &task)
+    {
+        auto &queue = *mQueues[queueIndex];
+        std::lock_guard lock(queue.sync);
+        if(queue.tasks.empty())
+            return false;
+
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool stealTask(const size_t thiefIndex, std::function<void()> &task)
+    {
+        for(size_t i = 1; i <= mQueues.size(); i++)
+        {
+            auto &queue = *mQueues[(thiefIndex + i) % mQueues.size()];
+            std::lock_guard lock(queue.sync);
+            if(queue.tasks.empty())
+                continue;
+
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    //Run one queued task if there is one. preferredQueue is checked first, then everything else is stolen from.
+    bool runPendingTask(const size_t preferredQueue)
+    {
+        std::function<void()> task;
+        if(!popTask(preferredQueue, task) && !stealTask(preferredQueue, task))
+            return false;
+
+        mPendingTasks--;
+        task();
+        return true;
+    }
+
+    void workerLoop(const size_t workerIndex)
+    {
+        tCurrentPool = this;
+        tWorkerIndex = workerIndex;
+        Instrumentation::setThreadName("worker " + std::to_string(workerIndex));
+        while(true)
+        {
+            if(runPendingTask(workerIndex))
+                continue;
+
+            MS_SCOPED_TIMER(WorkerIdle);
+            std::unique_lock lock(mSleepSync);
+            mTasksAvailable.wait(lock, [this]() { return mPendingTasks > 0 || !mIsRunning; });
+            if(!mIsRunning && mPendingTasks == 0)
+                return;
+        }
+    }
+
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard lock(mSleepSync); //Taking the lock means a worker can't miss the wakeup between checking and sleeping.
+            mPendingTasks++;                  //Counted before it's queued so the count never drops below zero.
+        }
+
+        const size_t queueIndex = (tCurrentPool == this) ? tWorkerIndex : mNextQueue++ % mQueues.size();
+        {
+            auto &queue = *mQueues[queueIndex];
+            std::lock_guard lock(queue.sync);
+            queue.tasks.push_back(std::move(task));
+        }
+        mTasksAvailable.notify_one();
+    }
+
+public:
+    explicit ThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        threadCount = std::max<size_t>(threadCount, 1);
+        for(size_t i = 0; i < threadCount; i++)
+            mQueues.push_back(std::make_unique<WorkerQueue>());
+        for(size_t i = 0; i < threadCount; i++)
+            mThreads.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~ThreadPool() //Finishes everything that has been queued before the threads exit.
+    {
+        {
+            std::lock_guard lock(mSleepSync);
+            mIsRunning = false;
+        }
+        mTasksAvailable.notify_all();
+        for(auto &thread : mThreads)
+            thread.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t getThreadCount() const
+    {
+        return mThreads.size();
+    }
+
+    //Queue a task, the returned future becomes ready (and holds any exception) once it has run.
+    template<typename Function>
+    auto submit(Function &&function) -> std::future<std::invoke_result_t<std::decay_t<Function>>>
+    {
+        using ResultType = std::invoke_result_t<std::decay_t<Function>>;
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Function>(function));
+        auto result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    //Call function(index) for every index in [0, count) and wait for all of them to finish.
+    //The calling thread works through indices too, so it is safe to call from inside a pool task. It only ever runs indices of this job, picking up
+    //unrelated queued tasks (a whole other frame in main.cpp) while waiting would hold this call up until that task is done.
+    //If function throws, the indices nobody has started are skipped and the first exception is rethrown here once every index has finished.
+    template<typename Function>
+    void parallelFor(const size_t count, Function &&function)
+    {
+        if(count == 0)
+            return;
+
+        struct Job
+        {
+            std::atomic<size_t> nextIndex{0};
+            std::atomic<size_t> finishedCount{0};
+            std::mutex finishedSync;
+            std::condition_variable finished;
+            std::exception_ptr error; //First exception thrown by function, guarded by finishedSync
+            std::atomic<bool> failed{false};
+        };
+        auto job = std::make_shared<Job>(); //Helpers may only get scheduled after this call has returned, so they share ownership.
+        const size_t totalCount = count;
+
+        //Each helper claims indices until there are none left, so a helper that starts late simply does nothing.
+        auto runIndices = [job, totalCount, &function]()
+        {
+            size_t index;
+            while((index = job->nextIndex.fetch_add(1)) < totalCount)
+            {
+                if(!job->failed)
+                {
+                    try
+                    {
+                        function(index);
+                    }
+                    catch(...) //Escaping would terminate a worker, or leave helpers calling function after the caller has unwound
+                    {
+                        std::lock_guard lock(job->finishedSync);
+                        if(!job->error)
+                            job->error = std::current_exception();
+                        job->failed = true;
+                    }
+                }
+                if(job->finishedCount.fetch_add(1) + 1 == totalCount)
+                {
+                    std::lock_guard lock(job->finishedSync);
+                    job->finished.notify_all();
+                }
+            }
+        };
+
+        const size_t helperCount = std::min(count - 1, mThreads.size());
+        for(size_t i = 0; i < helperCount; i++)
+            enqueue(runIndices);
+
+        runIndices();
+
+        //Every index has been claimed, the ones still running are on threads that are already working on them, so blocking can't deadlock.
+        std::unique_lock lock(job->finishedSync);
+        job->finished.wait(lock, [&job, totalCount]() { return job->finishedCount == totalCount; });
+        if(job->error)
+            std::rethrow_exception(job->error);
+    }
+};
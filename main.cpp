@@ -1,197 +1,174 @@
 #include <iostream>
 #include <thread>
-#include <mutex>
 #include <chrono>
 #include <future>
+#include <sstream>
+#include <iomanip>
 #include "SFML/Graphics.hpp"
 
-//https://github.com/Reputeless/PerlinNoise
-#include "PerlinNoise.hpp"
-#include "MarchingSquares.hpp"
+#include "FrameQueue.hpp"
+#include "Generators.hpp"
 
-class [[maybe_unused]] PerlinHeightmapGenerator : public ISquaresGenerator
+static sf::Color getIsoLevelColor(double isoLevel)
 {
-    const siv::PerlinNoise mPerlin;     //Noise generator
-    double mOffsetX, mOffsetY, mOffsetZ;//Noise offsets
-    size_t mResolutionX, mResolutionY;  //Total points x/y probably not the best variable names for this, but whatever.
+    auto color = sf::Color::White;
+    if(isoLevel < 0.5) color = sf::Color::Green;
+    if(isoLevel < 0.4) color = sf::Color::Red;
+    return color;
+}
+
+//Convert the MarchingSquares output to something SFML can use.
+class [[maybe_unused]] SFMLMarchingSquaresOutput : public ISquaresOutput
+{
+    sf::VertexArray mVertices;
+    std::vector<sf::Color> mIsoLevelColors; //Colour of each iso level, so bulk writes don't need to pick a colour per vertex.
+
 public:
-    //Init the seed the perlin generator and initialize member variables.
-    PerlinHeightmapGenerator(size_t resolutionX, size_t resolutionY, size_t seed) : mPerlin(seed), mOffsetX(0.0), mOffsetY(0.0), mOffsetZ(1.0), mResolutionX(resolutionX), mResolutionY(resolutionY)
-    {}
+    //Lines for renderIsolines(), triangles for everything else
+    explicit SFMLMarchingSquaresOutput(sf::PrimitiveType primitiveType = sf::PrimitiveType::Triangles) : mVertices(primitiveType) {}
+    void resetVertices(size_t vertexCount) override //clear vertex data and set the size of the buffer, this avoids 1000s of memory allocations
+    {
+        mVertices.clear(); //Keeps the capacity, so after the first few frames this never reallocates.
+        mVertices.resize(vertexCount);
+    }
 
-    double getPoint(size_t x, size_t y) override//Get the perlin noise for a point
+    void addVertex(double isoLevel, double x, double y)  override//Very slow, reallocates the buffer and copies the old one to the new one.
     {
-        return mPerlin.accumulatedOctaveNoise3D_0_1(static_cast<double>(x / (mResolutionX / 2.0)) + mOffsetX,
-                                                    static_cast<double>(y / (mResolutionY / 2.0)) + mOffsetY,
-                                                    mOffsetZ, 4);
+        mVertices.append({{static_cast<float>(x), static_cast<float>(y)}, getIsoLevelColor(isoLevel)});
     }
 
-    //step is a nice helper function to have so swapping out point generators is a bit easier.
-    void step(const double delta)
+    void setVertex(size_t vertexIndex, double x, double y) override //Very fast, simply assign vertex data to an already allocated slot in the buffer.
     {
-        mOffsetZ += delta;
+        mVertices[vertexIndex] = {{static_cast<float>(x), static_cast<float>(y)}, sf::Color::White};
     }
 
-    void setOffsets(double x, double y, double z) //Set the offset the perlin landscape position
+    void setIsoLevels(const std::vector<double> &isoLevels) override
     {
-        mOffsetX = x;
-        mOffsetY = y;
-        mOffsetZ = z;
+        mIsoLevelColors.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mIsoLevelColors.begin(), getIsoLevelColor);
     }
 
-    void moveOffsets(double x, double y, double z) //Move the offset the perlin landscape position
+    void writeVertices(size_t firstVertex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override //Fast path used by render()
     {
-        mOffsetX += x;
-        mOffsetY += y;
-        mOffsetZ += z;
+        const auto color = mIsoLevelColors[isoLevelIndex];
+        for(size_t i = 0; i < vertices.size(); i++)
+            mVertices[firstVertex + i] = {{vertices[i].x, vertices[i].y}, color};
     }
 
-    void setResolution(size_t x, size_t y)  //Change the resolution of the perlin noise (higher numbers will "zoom in")
+    const sf::VertexArray &getVertices() //Get all the vertex data for drawing
     {
-        mResolutionX = x;
-        mResolutionY = y;
+        return this->mVertices;
     }
 };
 
-class MetaBallsGenerator : public ISquaresGenerator
+//Output for MarchingSquares::renderPolylines(), a line strip per contour for displays that only want the lines.
+class [[maybe_unused]] SFMLPolylineOutput : public ISquaresPolylineOutput, public sf::Drawable
 {
-    size_t mResolutionX, mResolutionY;
-    //CenterX CenterY VelocityX, VelocityY Radius
-    std::vector<std::tuple<double, double, double, double, double>> mMetaBalls;
+    std::vector<sf::VertexArray> mLines;
+    std::vector<sf::Color> mIsoLevelColors;
 
-    void updatePositions(double delta)
+    void draw(sf::RenderTarget &target, sf::RenderStates states) const override
     {
-        for(auto &metaball : mMetaBalls)
-        {
-            auto &[posX, posY, velX, velY, radius] = metaball; //What an awesome way to tie variables to a tuple.
-
-            posX += (velX * delta);
-            posY += (velY * delta);
-
-            //I hate this, but couldn't be bothered implementing it properly.
-            //It essentially rotates the direction vector 90 degrees on collision with the boundary.
-            //Maybe it would be cool to implement ball collisions
-            if((posX - radius) < 0.0 || (posX + radius) > mResolutionX)
-                velX = -velX;
-            if((posY - radius) < 0.0 || (posY + radius) > mResolutionY)
-                velY = -velY;
-        }
-
+        for(const auto &line : mLines)
+            target.draw(line, states);
     }
 
 public:
-    MetaBallsGenerator(size_t resolutionX, size_t resolutionY, size_t seed) : mResolutionX(resolutionX), mResolutionY(resolutionY)
-    {
-        //Random balls with random sizes with random directions
-        std::default_random_engine generator(seed);
-        std::uniform_int_distribution<int> ballCountDist(2, 10);
-        std::uniform_real_distribution<double> radiusDist(2, resolutionX * 0.15); //Based on percentage of total points so sizes are consistent.
-                                                                                  //(kind of, since it's not relative to window size).
-        for(int i = ballCountDist(generator); i > 0; i--)
-        {
-            double radius = radiusDist(generator);
-
-            std::uniform_real_distribution<double> posXDist(radius + 1.0, resolutionX - radius - 1.0); //At least try not to spawn balls in the walls.
-            std::uniform_real_distribution<double> posYDist(radius + 1.0, resolutionY - radius - 1.0);
-            std::uniform_real_distribution<double> speedDistX(-(resolutionX * 2.0), resolutionX * 2.0); //Not too fast, based on a percentage of total points
-            std::uniform_real_distribution<double> speedDistY(-(resolutionY * 2.0), resolutionY * 2.0); //so speed is always consistent. (kind of, since it's not
-                                                                                                        //relative to window size).
-
-             mMetaBalls.emplace_back(std::make_tuple(posXDist(generator), posYDist(generator), speedDistX(generator), speedDistY(generator), radius));
-        }
-    }
-
-    double getPoint(size_t x, size_t y) override
+    void resetPolylines(const std::vector<double> &isoLevels) override
     {
-        double ret = 0.0;
-        for(auto &metaball : mMetaBalls)
-        {
-            auto &[posX, posY, velX, velY, radius] = metaball;
-
-            //define our circle in a way that as the distance from the center increases, the returned value is smaller.
-            //This makes the "blobiness" effect instead of well defined boundaries.
-            ret += ((radius*radius) / (((static_cast<double>(x) - posX) * (static_cast<double>(x) - posX)) + ((static_cast<double>(y) - posY) * (static_cast<double>(y) - posY)))) * 0.3;
-
-        }
-        return ret;
+        mLines.clear();
+        mIsoLevelColors.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mIsoLevelColors.begin(), getIsoLevelColor);
     }
 
-    void step(double delta)
+    void addPolylines(size_t isoLevelIndex, std::span<const SquaresVertex> vertices, std::span<const SquaresPolyline> polylines) override
     {
-        //This helps with multi-threading
-        //as each thread jumps forward a few steps it will run the simulation forward to the current thread's step.
-        while(delta > 0.0001)
+        const auto color = mIsoLevelColors[isoLevelIndex];
+        for(const auto &polyline : polylines)
         {
-            updatePositions(0.0001);
-            delta -= 0.0001;
+            auto &line = mLines.emplace_back(sf::PrimitiveType::LineStrip, polyline.vertexCount + (polyline.closed ? 1 : 0));
+            for(size_t i = 0; i < line.getVertexCount(); i++)
+            {
+                const auto &vertex = vertices[polyline.firstVertex + (i % polyline.vertexCount)]; //Closed lines repeat their first vertex
+                line[i] = {{vertex.x, vertex.y}, color};
+            }
         }
-        if(delta > 0.0)
-            updatePositions(delta);
     }
 };
 
-//this just helped me with implementing the interpolation algorithms.
-class TestPattern : public ISquaresGenerator
+//Output for MarchingSquares::update(), a VertexArray per chunk and iso level. Only the chunks that changed get rebuilt, the rest are drawn as they are.
+class SFMLChunkedMarchingSquaresOutput : public ISquaresChunkedOutput, public sf::Drawable
 {
-    constexpr static size_t TestPatternWidth = 5;
-    constexpr static size_t TestPatternHeight = 5;
-    constexpr static const std::array<double, 25> mTestPattern{ 0.0, 0.1, 0.1, 0.3, 0.2,
-                                                                0.1, 0.3, 0.6, 0.6, 0.3,
-                                                                0.3, 0.7, 0.9, 0.7, 0.3,
-                                                                0.2, 0.7, 0.8, 0.6, 0.2,
-                                                                0.1, 0.2, 0.3, 0.4, 0.7};
-public:
-    double getPoint(size_t x, size_t y) override
+    std::vector<sf::VertexArray> mChunks; //All the chunks of the first iso level, then the second... so levels are drawn in the same order as render().
+    std::vector<sf::Color> mIsoLevelColors;
+    size_t mChunkCount = 0;
+
+    void draw(sf::RenderTarget &target, sf::RenderStates states) const override
     {
-        return mTestPattern[(y * TestPatternWidth) + x];
+        for(const auto &chunk : mChunks)
+            target.draw(chunk, states);
     }
-};
-
-//Convert the MarchingSquares output to something SFML can use.
-class SFMLMarchingSquaresOutput : public ISquaresOutput
-{
-    sf::VertexArray mVertices;
 
 public:
-    SFMLMarchingSquaresOutput() : mVertices(sf::PrimitiveType::Triangles) {}
-    void resetVertices(size_t vertexCount) override //clear vertex data and set the size of the buffer, this avoids 1000s of memory allocations
+    void resetChunks(size_t chunkCountX, size_t chunkCountY, const std::vector<double> &isoLevels) override
     {
-        mVertices.clear();
-        mVertices.resize(vertexCount);
+        mChunkCount = chunkCountX * chunkCountY;
+        mChunks.assign(mChunkCount * isoLevels.size(), sf::VertexArray(sf::PrimitiveType::Triangles));
+        mIsoLevelColors.resize(isoLevels.size());
+        std::transform(isoLevels.begin(), isoLevels.end(), mIsoLevelColors.begin(), getIsoLevelColor);
     }
 
-    void addVertex(double isoLevel, double x, double y)  override//Very slow, reallocates the buffer and copies the old one to the new one.
+    void updateChunk(size_t chunkIndex, size_t isoLevelIndex, std::span<const SquaresVertex> vertices) override
     {
-        auto color = sf::Color::White;
-        if(isoLevel < 0.5) color = sf::Color::Green;
-        if(isoLevel < 0.4) color = sf::Color::Red;
-
-        mVertices.append({{static_cast<float>(x), static_cast<float>(y)}, color});
+        auto &chunk = mChunks[(isoLevelIndex * mChunkCount) + chunkIndex];
+        const auto color = mIsoLevelColors[isoLevelIndex];
+        chunk.resize(vertices.size()); //Keeps its capacity, so a chunk only reallocates when it grows
+        for(size_t i = 0; i < vertices.size(); i++)
+            chunk[i] = {{vertices[i].x, vertices[i].y}, color};
     }
+};
 
-    void setVertex(size_t vertexIndex, double x, double y) override //Very fast, simply assign vertex data to an already allocated slot in the buffer.
-    {
-        mVertices[vertexIndex] = {{static_cast<float>(x), static_cast<float>(y)}, sf::Color::White};
-    }
+//Everything needed to produce one frame. Several of these are in flight at once, handed out in frame order by a FrameQueue.
+//Frames are rendered by tasks on the thread pool, so whichever worker is free picks up the next one.
+template<class GeneratorType, class SquaresType>
+struct FrameJob
+{
+    FrameJob(size_t pointsX, size_t pointsY, size_t seed) : generator(pointsX, pointsY, seed), squares(generator, output) {}
 
-    const sf::VertexArray &getVertices() //Get all the vertex data for drawing
-    {
-        return this->mVertices;
-    }
+    GeneratorType generator;
+    SFMLChunkedMarchingSquaresOutput output; //Each frame in flight gets it's own vertices.
+    SquaresType squares;
+    uint64_t sequence = 0; //Frame the generator is at
+    std::future<void> result; //Only waited on at shutdown, the render loop goes by the FrameQueue.
 };
 
-//Holds info to help with multi-threading
-struct WorkerThread
+//Per frame breakdown of where the time went since the last update, replaces the bare FPS counter when instrumentation is compiled in.
+static std::string getStatsOverlayText(const size_t framesPerSecond, const Instrumentation::Snapshot &interval, const size_t frameCount)
 {
-    explicit WorkerThread() : threadId(0), isRunning(true) {}
-
-    std::future<void> result;
-    size_t threadId = 0;        //tells the thread where in the queue it is so it can offset it's output accordingly.
-    std::atomic<bool> invalidated; //tells the thread to render the next frame.
-    bool isRunning; //Flag tells the thread when to exit it's busy loop
-    SFMLMarchingSquaresOutput output; //Each thread gets it's own VertexBuffer.
-    std::mutex threadSync; //Synchronize access to output.
-};
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << "fps " << framesPerSecond << "\n";
+    if(frameCount == 0)
+        return text.str();
+
+    const auto frames = static_cast<double>(frameCount);
+    const auto total = interval.getTotal();
+    text << "ms per frame (all threads)\n";
+    for(size_t stage = 0; stage < Instrumentation::StageCount; stage++)
+        if(stage != static_cast<size_t>(Instrumentation::Stage::WorkerIdle))
+            text << "  " << Instrumentation::StageNames[stage] << " " << total.getStageMilliseconds(static_cast<Instrumentation::Stage>(stage)) / frames << "\n";
+
+    text << "cells " << total.getCounter(Instrumentation::Counter::CellsVisited) / frameCount
+         << " non-empty " << total.getCounter(Instrumentation::Counter::NonEmptyCells) / frameCount << "\n";
+    text << "vertices";
+    for(size_t isoLevelIndex = 0; isoLevelIndex < Instrumentation::MaxIsoLevels && total.levelVertices[isoLevelIndex] > 0; isoLevelIndex++)
+        text << " " << total.levelVertices[isoLevelIndex] / frameCount;
+    text << "\n";
+
+    for(const auto &thread : interval.threads) //Idle time per worker shows how well the pool keeps up with the frames in flight
+        if(thread.stageCalls[static_cast<size_t>(Instrumentation::Stage::WorkerIdle)] > 0)
+            text << thread.name << " idle " << thread.getStageMilliseconds(Instrumentation::Stage::WorkerIdle) / frames << "ms\n";
+    return text.str();
+}
 
 int main()
 {
@@ -200,51 +177,40 @@ int main()
     constexpr size_t          PixelsPerPointX = 4; //Resolution of the display, higher numbers means the points a further apart.
     constexpr size_t          PixelsPerPointY = 4;
     constexpr double          DepthIncrementAmountPerFrame = 0.0005; //We are using 3d perlin noise, how fast should we "travel" through the Z axis.
-    constexpr size_t          ThreadCount = 6;  //How many worker threads should we use. Probably better to use std::thread::hardware_concurrency()
+    constexpr size_t          FramesInFlight = 6;  //How many frames are worked on at once.
+    const size_t              ThreadCount = std::max(1u, std::thread::hardware_concurrency()); //Worker threads in the pool, frames are also split between them.
     const std::vector<double> IsoLevels{0.3,0.4,0.5};   //Threshold for a 1 or 0 on points of the square.
 
     sf::RenderWindow window(sf::VideoMode(PointsX * PixelsPerPointX, PointsY * PixelsPerPointY), "Marching Squares Example");
     size_t seed = std::chrono::steady_clock::now().time_since_epoch().count();
+
+    using Generator = PerlinHeightmapGenerator; //MetaBallsGenerator works here too
+    using Squares = MarchingSquares<PointsX, PointsY, PixelsPerPointX, PixelsPerPointY, float>; //Perlin noise doesn't need double precision, floats halve the grid
+    using Job = FrameJob<Generator, Squares>;
+
+    ThreadPool threadPool(ThreadCount);
+    FrameQueue<Job> frameQueue;
+    for(size_t frameIndex = 0; frameIndex < FramesInFlight; frameIndex++)
+    {
+        auto job = std::make_unique<Job>(PointsX, PointsY, seed);
+        job->squares.setThreadPool(&threadPool); //Lets idle workers help out with a frame when there are more cores than frames in flight.
+        frameQueue.addSlot(std::move(job));
+    }
+
     /**********************************************************************************************************************
-                                            calculationThread Lambda
+                                            startFrame Lambda
                             Generate the vertex data required asynchronously
     **********************************************************************************************************************/
-    std::array<WorkerThread, ThreadCount> workerThreads;
-    auto calculationThread = [seed, &IsoLevels, &workerThreads](const size_t threadId)
+    frameQueue.start([&threadPool, &frameQueue, &IsoLevels](Job &job, const uint64_t sequence, const size_t slotIndex)
     {
-        PerlinHeightmapGenerator generator(PointsX, PointsY, seed);
-        //MetaBallsGenerator generator(PointsX, PointsY, seed);
-
-        MarchingSquares<PointsX, PointsY, PixelsPerPointX, PixelsPerPointY> squares(generator, workerThreads[threadId].output);
-
-        //Start off at a depth relative to the thread's position in the queue and depth increment amount
-        generator.step(DepthIncrementAmountPerFrame * workerThreads[threadId].threadId);
-        while(workerThreads[threadId].isRunning)
+        job.result = threadPool.submit([&job, &frameQueue, &IsoLevels, sequence, slotIndex]()
         {
-            if(!workerThreads[threadId].invalidated) //Wait until the data has been used
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                continue;
-            }
-
-            workerThreads[threadId].threadSync.lock();
-            squares.recalculate(); //calculate point data
-            squares.render(IsoLevels);       //render the point data into vertices this is where the squares "march".
-
-            generator.step(DepthIncrementAmountPerFrame * ThreadCount);
-            workerThreads[threadId].invalidated = false; //new data has rendered and therefore valid for rendering again.
-            workerThreads[threadId].threadSync.unlock();
-
-        }
-    };
-
-    for(size_t threadIdCounter = 0; threadIdCounter < ThreadCount; threadIdCounter++)
-    {
-        workerThreads[threadIdCounter].result = std::move(std::async(std::launch::async, calculationThread, threadIdCounter));
-        workerThreads[threadIdCounter].threadId = threadIdCounter;
-        workerThreads[threadIdCounter].isRunning = true;
-        workerThreads[threadIdCounter].invalidated = true;
-    }
+            job.generator.step(DepthIncrementAmountPerFrame * static_cast<double>(sequence - job.sequence)); //Jump to the depth of the job's new frame
+            job.sequence = sequence;
+            job.squares.update(IsoLevels); //regenerate the points that changed and "march" the squares around them.
+            frameQueue.publish(slotIndex);
+        });
+    });
 
     sf::Font myFont;
     myFont.loadFromFile("Commodore.TTF");
@@ -254,8 +220,13 @@ int main()
     frameTimerText.setCharacterSize(24);
     frameTimerText.setFillColor(sf::Color::Yellow);
 
-    size_t frameCount = 0; //We need to keep track of frame numbers to select the correct thread in the queue to render.
+    bool showStatsOverlay = Instrumentation::Enabled; //F1 switches between the stats and plain FPS
+    Instrumentation::setThreadName("main");
+    auto lastSnapshot = Instrumentation::snapshot();
+
+    size_t frameCount = 0; //New frames shown, for the fps counter
     size_t savedFrameCount = 0;
+    uint64_t nextNewSequence = 0; //Anything from here on is a frame that hasn't been shown yet
     auto frameTimer = std::chrono::high_resolution_clock::now();
     while (window.isOpen())
     {
@@ -267,22 +238,47 @@ int main()
         {
             if (event.type == sf::Event::Closed)
                 window.close();
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F1 && Instrumentation::Enabled)
+                showStatsOverlay = !showStatsOverlay;
         }
         window.clear(); //clear the window for the next draw. Disable this for a trippy experience!
 
-        auto &threadInfo = workerThreads[frameCount++ % ThreadCount];
-        while(threadInfo.invalidated) std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        threadInfo.threadSync.lock();   //Get exclusive access to the vertex data, if the thread is not finished this will block here.
-        window.draw(threadInfo.output.getVertices());  //Draw the rendered vertex data
-        threadInfo.invalidated = true;  //Tell the thread to draw the next frame.
-        threadInfo.threadSync.unlock(); //Give back access to the vertex data
+        Job *job;
+        {
+            MS_SCOPED_TIMER(HandoffWait);
+            job = frameQueue.acquire(); //Never waits, the last frame is drawn again if nothing newer is ready.
+        }
+        if(job)
+        {
+            if(frameQueue.getDisplayedSequence() >= nextNewSequence)
+            {
+                frameCount++;
+                nextNewSequence = frameQueue.getDisplayedSequence() + 1;
+            }
+            MS_SCOPED_TIMER(Draw);
+            window.draw(job->output);  //Draw the rendered vertex data
+        }
 
         //fps seems to be too high to measure per-frame so I resorted to counting frames for fractions of a second like a neanderthal.
         constexpr size_t fpsScaleFactor = 1;
         if(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameTimer).count() >=
            1000.0 / fpsScaleFactor)
         {
-            frameTimerText.setString(std::to_string((frameCount - savedFrameCount) * fpsScaleFactor)); //Benchmarking
+            const size_t framesPerSecond = (frameCount - savedFrameCount) * fpsScaleFactor;
+            if(showStatsOverlay)
+            {
+                auto snapshot = Instrumentation::snapshot();
+                auto interval = snapshot;
+                for(size_t i = 0; i < lastSnapshot.threads.size(); i++) //Threads are never removed, so they line up with the last snapshot
+                    interval.threads[i] -= lastSnapshot.threads[i];
+                frameTimerText.setString(getStatsOverlayText(framesPerSecond, interval, frameCount - savedFrameCount));
+                lastSnapshot = std::move(snapshot);
+            }
+            else
+            {
+                frameTimerText.setString(std::to_string(framesPerSecond)); //Benchmarking
+                lastSnapshot = Instrumentation::snapshot();
+            }
             frameTimer = std::chrono::high_resolution_clock::now();
             savedFrameCount = frameCount;
         }
@@ -294,13 +290,6 @@ int main()
         //std::this_thread::sleep_for(sleepTimer); - Has a rather large minimum sleep time so no use here.
         sf::sleep(sf::microseconds(sleepTimer.count()));
     }
-    for(auto &threadInfo : workerThreads)
-    {
-        threadInfo.threadSync.lock();
-        threadInfo.isRunning = false;
-        threadInfo.threadSync.unlock();
-
-        threadInfo.result.get();
-    }
+    frameQueue.forEachFrame([](Job &job) { job.result.wait(); }); //Let the last frames finish before their buffers go away.
     return 0;
 }